@@ -7,6 +7,20 @@
 DISP_PG0 = $0300
 DISP_PG1 = $0400
 
+; Blitter registers, see include/Devices/blitter.h
+BLIT_DST = $0212
+BLIT_WIDTH = $0214
+BLIT_HEIGHT = $0215
+BLIT_DST_STRIDE = $0217
+BLIT_FILL = $0218
+BLIT_CMD = $0219
+BLIT_OP_FILL = 1
+
+; Interrupt registers, see include/Devices/interrupts.h
+IRQ_STATUS = $0234
+WAIT = $0235
+IRQ_VSYNC = 2
+
 ; The following zero page addresses are all used to flip on a pixel at a specified (x,y) position
 z_paint_pattern = 0
 ; The following two form an address to the place in display
@@ -56,8 +70,7 @@ game_loop:
 ; {
   jsr game_update
   jsr game_draw
-  jsr mega_burn_cpu
-  jsr mega_burn_cpu
+  jsr wait_frame
   jmp game_loop
 ; }
 
@@ -86,18 +99,20 @@ game_draw:
 
 clear_screen:
 ; {
+  ; 64 rows of 8 bytes, filled with 0 by the blitter.
+  lda #<DISP_PG0
+  sta BLIT_DST
+  lda #>DISP_PG0
+  sta BLIT_DST+1
+  lda #8
+  sta BLIT_WIDTH
+  sta BLIT_DST_STRIDE
+  lda #64
+  sta BLIT_HEIGHT
   lda #0
-  ldx #0
-c_write_pg1:
-  sta DISP_PG0,X
-  inx
-  cpx #0
-  bne c_write_pg1
-c_write_pg2:
-  sta DISP_PG1,X
-  inx
-  cpx #0
-  bne c_write_pg2
+  sta BLIT_FILL
+  lda #BLIT_OP_FILL
+  sta BLIT_CMD
   rts
 ; }
 
@@ -204,41 +219,12 @@ or_to_display:
   rts
 ; }
 
-mega_burn_cpu:
-; {
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  jsr burn_cpu
-  rts
-; }
-
-burn_cpu:
+wait_frame:
 ; {
-  pha
-  ldx #0
-b_outer:
-  lda #0
-b_inner:
-  clc
-  adc #1
-  ; jsr burn_cpu2
-  bcc b_inner
-  inx
-  cpx #$ff
-  bne b_outer
-  pla
+  ; Sleep until a frame has finished, unless one already did while we were
+  ; busy, then acknowledge it.
+  lda #IRQ_VSYNC
+  sta WAIT
+  sta IRQ_STATUS
   rts
 ; }
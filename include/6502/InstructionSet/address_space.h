@@ -55,6 +55,81 @@ class IO {
  public:
   static constexpr word_t mouse_x = Regions::IO.begin | 0x00;
   static constexpr word_t mouse_y = Regions::IO.begin | 0x01;
+
+  /// Blitter, see Devices/blitter.h. Addresses are little endian words.
+  static constexpr word_t blit_src = Regions::IO.begin | 0x10;
+  static constexpr word_t blit_dst = Regions::IO.begin | 0x12;
+  /// Bytes per row and number of rows. 0 means 256.
+  static constexpr word_t blit_width = Regions::IO.begin | 0x14;
+  static constexpr word_t blit_height = Regions::IO.begin | 0x15;
+  /// Distance in bytes from the start of one row to the next.
+  static constexpr word_t blit_src_stride = Regions::IO.begin | 0x16;
+  static constexpr word_t blit_dst_stride = Regions::IO.begin | 0x17;
+  /// Byte written by \c BlitOp::FILL.
+  static constexpr word_t blit_fill = Regions::IO.begin | 0x18;
+  /// Writing a \c BlitOp here runs it.
+  static constexpr word_t blit_cmd = Regions::IO.begin | 0x19;
+  /// Guest cycles the last command took, as a word. Written by the blitter.
+  static constexpr word_t blit_cost = Regions::IO.begin | 0x1A;
+
+  /// Math unit, see Devices/mathunit.h. Words are little endian.
+  static constexpr word_t math_a = Regions::IO.begin | 0x20;
+  static constexpr word_t math_b = Regions::IO.begin | 0x22;
+  /// Writing a \c MathOp here runs it.
+  static constexpr word_t math_op = Regions::IO.begin | 0x24;
+  /// \c MathStatus bits of the last operation.
+  static constexpr word_t math_status = Regions::IO.begin | 0x25;
+  /// 32 bit result and 16 bit remainder of the last operation.
+  static constexpr word_t math_result = Regions::IO.begin | 0x26;
+  static constexpr word_t math_remainder = Regions::IO.begin | 0x2A;
+
+  /// Timer and interrupts, see Devices/interrupts.h.
+  /// Timer period in guest cycles, as a word. 0 means 65536.
+  static constexpr word_t timer_period = Regions::IO.begin | 0x30;
+  /// \c TimerControl bits. Setting \c TIMER_RUN (re)starts the period.
+  static constexpr word_t timer_ctrl = Regions::IO.begin | 0x32;
+  /// \c IrqSource bits which raise an IRQ when pending.
+  static constexpr word_t irq_enable = Regions::IO.begin | 0x33;
+  /// \c IrqSource bits which fired since they were last acknowledged.
+  /// Writing 1 bits acknowledges those sources.
+  static constexpr word_t irq_status = Regions::IO.begin | 0x34;
+  /// Writing a mask of \c IrqSource bits halts the CPU until one of them is
+  /// pending or an IRQ is taken. 0 waits for any source.
+  static constexpr word_t wait = Regions::IO.begin | 0x35;
+  /// Counts finished frames, wrapping around.
+  static constexpr word_t frame = Regions::IO.begin | 0x36;
+
+  /// Display, see Render/framebuffer.h.
+  /// \c DisplayMode of the framebuffer. 0 is the original 64x64 mono mode.
+  static constexpr word_t display_mode = Regions::IO.begin | 0x40;
+  /// Page the framebuffer starts on. 0 means \c Regions::DISPLAY.
+  static constexpr word_t display_base = Regions::IO.begin | 0x41;
+  /// 16 palette entries as RGB332, used by every mode but the mono one.
+  static constexpr word_t palette = Regions::IO.begin | 0x50;
+
+  /// Audio, see Devices/audio.h. Periods are little endian words counting
+  /// guest cycles, 0 silencing the channel. Volumes go from 0 to 15.
+  /// A square channel is high for one period and low for the next.
+  static constexpr word_t audio_square0_period = Regions::IO.begin | 0x60;
+  static constexpr word_t audio_square0_volume = Regions::IO.begin | 0x62;
+  static constexpr word_t audio_square1_period = Regions::IO.begin | 0x64;
+  static constexpr word_t audio_square1_volume = Regions::IO.begin | 0x66;
+  /// The noise channel takes a pseudo-random step every period.
+  static constexpr word_t audio_noise_period = Regions::IO.begin | 0x68;
+  static constexpr word_t audio_noise_volume = Regions::IO.begin | 0x6A;
+  /// Signed 8 bit level added to the mix, 0 being silence.
+  static constexpr word_t audio_dac = Regions::IO.begin | 0x6B;
+
+  /// Console, see Devices/console.h. Each register prints the byte written
+  /// to it, as a character, 2 hex digits, unsigned or signed decimal, or
+  /// 8 binary digits.
+  static constexpr word_t console_char = Regions::IO.begin | 0x70;
+  static constexpr word_t console_hex = Regions::IO.begin | 0x71;
+  static constexpr word_t console_dec = Regions::IO.begin | 0x72;
+  static constexpr word_t console_signed = Regions::IO.begin | 0x73;
+  static constexpr word_t console_bin = Regions::IO.begin | 0x74;
+  /// Any write sends the text so far on to the host's output.
+  static constexpr word_t console_flush = Regions::IO.begin | 0x75;
 };
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef SIXFIVE_ARITHMETIC_H
+#define SIXFIVE_ARITHMETIC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// Precomputed results for ADC and SBC in both binary and decimal mode. Each
+/// entry packs the new accumulator into its low byte and the C, Z, V and N
+/// flags into its high byte, laid out the same way they are in the status
+/// register. That way a single load gives the whole result of the operation.
+class ArithTables {
+ public:
+  /// Status register bits written by ADC and SBC (NV____ZC).
+  static constexpr uint8_t FLAGS_MASK = 0b11000011;
+
+  /// One entry for every (decimal, carry, accumulator, operand) combination.
+  static constexpr size_t TABLE_SZ = 2 * 2 * 256 * 256;
+  using Table = std::array<uint16_t, TABLE_SZ>;
+
+  static inline size_t index(bool decimal, bool carry, uint8_t ac,
+                             uint8_t operand) {
+    return static_cast<size_t>(decimal) << 17 |
+           static_cast<size_t>(carry) << 16 | static_cast<size_t>(ac) << 8 |
+           operand;
+  }
+
+  static const Table ADC;
+  static const Table SBC;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SIXFIVE_FUSIONS_H
+#define SIXFIVE_FUSIONS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Superinstructions: fixed sequences of opcodes which are executed by a single
+/// handler. The catalogue lives in fusions.def.
+enum class Fusion : uint8_t {
+#define FUSE2(name, first, second) name,
+#define FUSE3(name, first, second, third) name,
+#include "6502/InstructionSet/fusions.def"
+  NONE,
+};
+
+static constexpr size_t NUM_FUSIONS = static_cast<size_t>(Fusion::NONE);
+
+/// Longest sequence a fusion can cover.
+static constexpr uint8_t MAX_FUSION_LEN = 3;
+
+/// Fusion descriptor.
+struct FusionDesc {
+  const char* name;
+  /// Number of instructions in the sequence.
+  uint8_t len;
+  std::array<Opcode, MAX_FUSION_LEN> ops;
+  /// Byte offset of each instruction from the start of the sequence.
+  std::array<uint8_t, MAX_FUSION_LEN> offsets;
+  /// Total size of the sequence in bytes.
+  uint8_t sz;
+  /// Sum of the base cycles of every instruction in the sequence.
+  uint8_t cycles;
+};
+
+constexpr FusionDesc make_fusion(const char* name, uint8_t len,
+                                 std::array<Opcode, MAX_FUSION_LEN> ops) {
+  FusionDesc desc{name, len, ops, {}, 0, 0};
+  for (uint8_t i = 0; i < len; i++) {
+    InstDesc inst = byte_to_inst(static_cast<uint8_t>(ops[i]));
+    desc.offsets[i] = desc.sz;
+    desc.sz += inst.sz;
+    desc.cycles += inst.cycles;
+  }
+  return desc;
+}
+
+static constexpr FusionDesc FUSION_TABLE[NUM_FUSIONS] = {
+#define FUSE2(name, first, second) \
+  make_fusion(#name, 2, {Opcode::first, Opcode::second, Opcode::first}),
+#define FUSE3(name, first, second, third) \
+  make_fusion(#name, 3, {Opcode::first, Opcode::second, Opcode::third}),
+#include "6502/InstructionSet/fusions.def"
+};
+
+/// Set for every opcode which begins at least one fusion, so the dispatcher
+/// only has to look further ahead when a sequence could actually match.
+static constexpr std::array<bool, 256> FUSION_HEADS = [] {
+  std::array<bool, 256> heads{};
+  for (const FusionDesc& desc : FUSION_TABLE) {
+    heads[static_cast<uint8_t>(desc.ops[0])] = true;
+  }
+  return heads;
+}();
+
+#endif
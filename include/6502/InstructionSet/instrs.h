@@ -1,6 +1,7 @@
 #ifndef SIXFIVE_INSTRS_H
 #define SIXFIVE_INSTRS_H
 
+#include <array>
 #include <cassert>
 #include <cstdint>
 #include <ostream>
@@ -47,30 +48,131 @@ static std::ostream& operator<<(std::ostream& stream, const AdrMode& mode) {
   };
 }
 
+/// CPU models the interpreter can be specialized for. Both run the
+/// documented NMOS instruction set; they differ in the opcodes it leaves
+/// undefined.
+enum class CpuVariant : uint8_t {
+  /// NMOS 6502 with its stable undocumented opcodes, see instrs_nmos.def.
+  NMOS,
+  /// 65C02 additions, see instrs_65c02.def.
+  CMOS,
+};
+
 /// Instruction descriptor.
 struct InstDesc {
   Mnemonic mon;
   AdrMode mode;
   uint8_t sz;
+  /// Cycles taken when no page boundary is crossed and no branch is taken.
+  uint8_t cycles;
+  /// Set for reads which take an extra cycle when indexing crosses a page.
+  bool page_penalty;
 };
 
 static std::ostream& operator<<(std::ostream& stream, const InstDesc& desc) {
   return stream << desc.mon << " " << desc.mode << " " << (int)desc.sz << "b";
 }
 
-constexpr InstDesc byte_to_inst(uint8_t inst_byte) {
-  Mnemonic op = Mnemonic::INVALID;
-  AdrMode mode = AdrMode::INVALID;
-  switch (inst_byte) {
-#define INST(byte, iop, imode) \
-  case byte:                   \
-    op = Mnemonic::iop;        \
-    mode = AdrMode::imode;     \
-    break;
-#include "6502/InstructionSet/instrs.def"
+/// Base cycle count of the NMOS 6502 for \p mon in address mode \p mode.
+constexpr uint8_t base_cycles(Mnemonic mon, AdrMode mode) {
+  switch (mon) {
+    case Mnemonic::STA:
+    case Mnemonic::STX:
+    case Mnemonic::STY:
+    case Mnemonic::STZ:
+    case Mnemonic::SAX:
+      switch (mode) {
+        case AdrMode::ZPG:
+          return 3;
+        case AdrMode::ZP_X:
+        case AdrMode::ZP_Y:
+        case AdrMode::ABS:
+          return 4;
+        case AdrMode::ABS_X:
+        case AdrMode::ABS_Y:
+        case AdrMode::ZPG_IND:
+          return 5;
+        default:
+          return 6;
+      }
+    case Mnemonic::ASL:
+    case Mnemonic::LSR:
+    case Mnemonic::ROL:
+    case Mnemonic::ROR:
+    case Mnemonic::INC:
+    case Mnemonic::DEC:
+    case Mnemonic::TSB:
+    case Mnemonic::TRB:
+    case Mnemonic::SLO:
+    case Mnemonic::RLA:
+    case Mnemonic::SRE:
+    case Mnemonic::RRA:
+    case Mnemonic::DCP:
+    case Mnemonic::ISC:
+      switch (mode) {
+        case AdrMode::A:
+          return 2;
+        case AdrMode::ZPG:
+          return 5;
+        case AdrMode::ZP_X:
+        case AdrMode::ABS:
+          return 6;
+        case AdrMode::X_IND:
+        case AdrMode::IND_Y:
+          return 8;
+        default:
+          return 7;
+      }
+    case Mnemonic::PHA:
+    case Mnemonic::PHP:
+    case Mnemonic::PHX:
+    case Mnemonic::PHY:
+      return 3;
+    case Mnemonic::PLA:
+    case Mnemonic::PLP:
+    case Mnemonic::PLX:
+    case Mnemonic::PLY:
+      return 4;
+    case Mnemonic::JMP:
+      switch (mode) {
+        case AdrMode::IND:
+          return 5;
+        case AdrMode::ABS_X_IND:
+          return 6;
+        default:
+          return 3;
+      }
+    case Mnemonic::JSR:
+    case Mnemonic::RTS:
+    case Mnemonic::RTI:
+      return 6;
+    case Mnemonic::BRK:
+      return 7;
     default:
-      return {Mnemonic::INVALID, AdrMode::IMP, 0};
+      break;
   }
+  // Everything else reads its operand.
+  switch (mode) {
+    case AdrMode::ZPG:
+      return 3;
+    case AdrMode::ZP_X:
+    case AdrMode::ZP_Y:
+    case AdrMode::ABS:
+    case AdrMode::ABS_X:
+    case AdrMode::ABS_Y:
+      return 4;
+    case AdrMode::IND_Y:
+    case AdrMode::ZPG_IND:
+      return 5;
+    case AdrMode::X_IND:
+      return 6;
+    default:
+      return 2;
+  }
+}
+
+/// Descriptor of \p op in address mode \p mode.
+constexpr InstDesc describe_inst(Mnemonic op, AdrMode mode) {
   uint8_t sz = 0;
   switch (mode) {
     case AdrMode::IMP:
@@ -84,18 +186,76 @@ constexpr InstDesc byte_to_inst(uint8_t inst_byte) {
     case AdrMode::ZP_Y:
     case AdrMode::X_IND:
     case AdrMode::IND_Y:
+    case AdrMode::ZPG_IND:
       sz = 2;
       break;
     case AdrMode::ABS:
     case AdrMode::ABS_X:
     case AdrMode::ABS_Y:
     case AdrMode::IND:
+    case AdrMode::ABS_X_IND:
       sz = 3;
       break;
     case AdrMode::INVALID:
       assert(false && "unhandled address mode");
   }
-  return {op, mode, sz};
+  bool is_store = op == Mnemonic::STA || op == Mnemonic::STX ||
+                  op == Mnemonic::STY || op == Mnemonic::STZ ||
+                  op == Mnemonic::SAX;
+  bool is_rmw = op == Mnemonic::ASL || op == Mnemonic::LSR ||
+                op == Mnemonic::ROL || op == Mnemonic::ROR ||
+                op == Mnemonic::INC || op == Mnemonic::DEC ||
+                op == Mnemonic::SLO || op == Mnemonic::RLA ||
+                op == Mnemonic::SRE || op == Mnemonic::RRA ||
+                op == Mnemonic::DCP || op == Mnemonic::ISC;
+  bool page_penalty = !is_store && !is_rmw &&
+                      (mode == AdrMode::ABS_X || mode == AdrMode::ABS_Y ||
+                       mode == AdrMode::IND_Y);
+  return {op, mode, sz, base_cycles(op, mode), page_penalty};
+}
+
+/// Descriptor of the documented instruction \p inst_byte.
+constexpr InstDesc byte_to_inst(uint8_t inst_byte) {
+  switch (inst_byte) {
+#define INST(byte, iop, imode) \
+  case byte:                   \
+    return describe_inst(Mnemonic::iop, AdrMode::imode);
+#include "6502/InstructionSet/instrs.def"
+    default:
+      return {Mnemonic::INVALID, AdrMode::IMP, 0, 0, false};
+  }
+}
+
+/// Descriptor of \p inst_byte on \p cpu: the documented instruction, or
+/// else the variant's own.
+constexpr InstDesc variant_byte_to_inst(uint8_t inst_byte, CpuVariant cpu) {
+  InstDesc desc = byte_to_inst(inst_byte);
+  if (desc.mon != Mnemonic::INVALID) return desc;
+#define INST(byte, iop, imode) \
+  case byte:                   \
+    return describe_inst(Mnemonic::iop, AdrMode::imode);
+  switch (cpu) {
+    case CpuVariant::NMOS:
+      switch (inst_byte) {
+#include "6502/InstructionSet/instrs_nmos.def"
+      }
+      break;
+    case CpuVariant::CMOS:
+#define INST(byte, iop, imode) \
+  case byte:                   \
+    return describe_inst(Mnemonic::iop, AdrMode::imode);
+#define UNDEFINED(byte, imode, cyc)                              \
+  case byte: {                                                   \
+    InstDesc nop = describe_inst(Mnemonic::NOP, AdrMode::imode); \
+    nop.cycles = cyc;                                            \
+    return nop;                                                  \
+  }
+      switch (inst_byte) {
+#include "6502/InstructionSet/instrs_65c02.def"
+      }
+      break;
+  }
+  return desc;
 }
 
 static InstDesc INST_TABLE[256] = {
@@ -167,4 +327,14 @@ static InstDesc INST_TABLE[256] = {
 
 inline InstDesc decode_desc(uint8_t inst_byte) { return INST_TABLE[inst_byte]; }
 
+/// Instruction table of each CPU variant, for its specialized interpreter.
+template <CpuVariant CPU>
+inline constexpr std::array<InstDesc, 256> VARIANT_TABLE = [] {
+  std::array<InstDesc, 256> table{};
+  for (int byte = 0; byte < 256; byte++) {
+    table[byte] = variant_byte_to_inst(byte, CPU);
+  }
+  return table;
+}();
+
 #endif
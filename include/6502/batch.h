@@ -0,0 +1,147 @@
+#ifndef SIXFIVE_BATCH_H
+#define SIXFIVE_BATCH_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/InstructionSet/instrs.h"
+#include "6502/processor.h"
+#include "6502/sharedimage.h"
+
+/// Runs many instances of the same program in lockstep.
+///
+/// Lanes are kept in buckets by PC. Every tick the bucket at the lowest PC
+/// forms a group which executes that one instruction together: it is decoded
+/// and dispatched once, then applied to each lane of the group in one tight
+/// loop, and the group moves on to the bucket of the next PC as a whole (or as
+/// two halves, for a branch). A tick thus costs in proportion to the group,
+/// however many lanes there are elsewhere. Picking the lowest PC lets lanes
+/// which took different branches meet again once the paths rejoin. Lanes
+/// whose code differs from the group's, and opcodes without a lockstep
+/// handler, are run by a scalar \c Processor bound to that lane.
+///
+/// Checking every lane's code bytes each tick would cost as much as the
+/// instruction itself, so it is only done for pages on which lanes differ and
+/// for lanes whose scalar steps may have written anywhere. Pages are compared
+/// across lanes the first time code runs from them after the host had lane
+/// memory, rather than all at once.
+///
+/// Lanes are run \c CHUNK at a time, each chunk to the end, so that the lanes
+/// of a group stay in cache.
+///
+/// Lanes don't take timer interrupts or wait for vsync: the lockstep path never
+/// services them, so guests run here should not enable the timer.
+class BatchProcessor {
+ public:
+  /// Every lane starts with a copy-on-write view of \p image.
+  BatchProcessor(const std::vector<uint8_t>& image, size_t lanes);
+
+  size_t size() const { return lanes.size(); }
+
+  uint8_t* memory(size_t lane) {
+    host_touched = true;
+    return mem[lane].data();
+  }
+  const uint8_t* memory(size_t lane) const { return mem[lane].data(); }
+
+  /// Run every lane until it returns from its top-level routine or has
+  /// executed \p max_steps more instructions.
+  void run(uint64_t max_steps);
+
+  bool halted(size_t lane) const { return lanes[lane].done; }
+  uint8_t accumulator(size_t lane) const { return lanes[lane].AC; }
+  uint64_t cycle_count(size_t lane) const { return lanes[lane].cycles; }
+
+  /// Lane-instructions executed by the lockstep handlers and by the scalar
+  /// fallback.
+  uint64_t lockstep_steps() const { return vector_steps; }
+  uint64_t fallback_steps() const { return scalar_steps; }
+
+ private:
+  /// Marks a PC without a bucket.
+  static constexpr uint32_t NO_BUCKET = UINT32_MAX;
+  /// Lanes run to the end together. Every lane has its own zero page and
+  /// stack, so more at once than this only thrashes the cache and the TLB
+  /// without making the groups much larger.
+  static constexpr uint32_t CHUNK = 256;
+
+  /// One lane's machine state, together so that a group touches one cache
+  /// line per lane.
+  struct Lane {
+    /// Start of the lane's memory.
+    uint8_t* base;
+    uint64_t cycles;
+    uint64_t steps_left;
+    /// Only up to date while the lane isn't in a bucket: the bucket's PC is
+    /// the lane's.
+    word_t PC;
+    uint8_t AC;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t SR;
+    uint8_t SP;
+    /// Set once the lane returned from its top-level routine.
+    bool done;
+    /// Set when the lane's scalar steps may have written outside the stack.
+    bool unsure;
+
+    bool idle() const { return done || steps_left == 0; }
+  };
+
+  std::vector<Lane> lanes;
+  SharedImage image;
+  std::vector<SharedImage::View> mem;
+  std::vector<std::unique_ptr<Processor>> scalar;
+
+  /// Index into \c buckets of the lanes waiting at each PC.
+  std::vector<uint32_t> bucket_at;
+  /// Lists of lanes, each kept in use by at most one PC at a time so that
+  /// their storage is reused.
+  std::vector<std::vector<uint32_t>> buckets;
+  std::vector<uint32_t> free_buckets;
+  /// A bit per PC whose bucket isn't empty, and a bit per word of those
+  /// which isn't zero, to find the lowest PC in a few word scans.
+  std::array<uint64_t, ADDR_SPACE_SZ / 64> occupied{};
+  std::array<uint64_t, ADDR_SPACE_SZ / 64 / 64> occupied_words{};
+  /// The lanes of the group being run, and those of them which took a
+  /// branch.
+  std::vector<uint32_t> group;
+  std::vector<uint32_t> taken;
+
+  /// Pages whose contents may differ between lanes.
+  std::array<uint8_t, NUM_PAGES> written_pages{};
+  /// Pages compared across lanes since the host last had lane memory.
+  std::array<uint8_t, NUM_PAGES> compared_pages{};
+  /// Set when lane memory was handed out for writing since the last run.
+  bool host_touched = true;
+  /// Number of lanes with \c Lane::unsure set.
+  size_t unsure_lanes = 0;
+
+  uint64_t vector_steps = 0;
+  uint64_t scalar_steps = 0;
+
+  /// The bucket of \p pc, made if there is none.
+  std::vector<uint32_t>& bucket(word_t pc);
+  /// Put \p lane into the bucket of its PC, unless it is idle.
+  void enqueue(uint32_t lane);
+  /// Move the lanes of \p ids, which are all at \p pc, into its bucket.
+  /// Lanes out of steps are left out if \p any_idle is set. Empties \p ids.
+  void move_to(word_t pc, std::vector<uint32_t>& ids, bool any_idle);
+  /// Empty the bucket at the lowest PC into \c group. \return its PC, or
+  /// \c UINT32_MAX if every bucket is empty.
+  uint32_t take_lowest();
+  /// Mark \p page as written if any lane's copy differs from lane 0's.
+  void diff_page(uint8_t page);
+  /// Run the lanes in the buckets until every one is idle.
+  void run_queued();
+  /// Run one instruction of \p lane on its scalar processor.
+  void step_scalar(size_t lane);
+  /// Run \p desc for every lane in the group. \return false if there is no
+  /// lockstep handler for it.
+  bool step_group(const InstDesc& desc, word_t pc, const uint8_t* code);
+};
+
+#endif
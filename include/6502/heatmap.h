@@ -0,0 +1,41 @@
+#ifndef SIXFIVE_HEATMAP_H
+#define SIXFIVE_HEATMAP_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "6502/InstructionSet/address_space.h"
+
+/// Per address counts of memory traffic, collected by processors in builds
+/// with \c SFEM_HEATMAP defined (the SFEM_HEATMAP CMake option). Other builds
+/// don't count anything and leave memory accesses untouched.
+///
+/// Reads are instruction operands and stack pops, writes include pushes, and
+/// an execute is counted at the first byte of each instruction. Counters
+/// saturate rather than wrap.
+class AccessHeatmap {
+ public:
+  /// Side of the square image: one pixel per address, one row per page.
+  static constexpr int SIDE = 256;
+
+  std::array<uint32_t, ADDR_SPACE_SZ> reads{};
+  std::array<uint32_t, ADDR_SPACE_SZ> writes{};
+  std::array<uint32_t, ADDR_SPACE_SZ> execs{};
+
+  static inline void count(std::array<uint32_t, ADDR_SPACE_SZ>& counters,
+                           word_t addr) {
+    counters[addr] += counters[addr] != UINT32_MAX;
+  }
+
+  void clear();
+
+  /// Draw the counts into \p rgba, \c SIDE by \c SIDE pixels packed R, G, B,
+  /// A in memory. Writes are red, reads green and executes blue, each on a
+  /// log scale up to the busiest address of its kind.
+  void to_rgba(uint32_t* rgba) const;
+  /// Save the image \c to_rgba draws as a PNG. \return false on failure.
+  bool save_png(const std::string& path) const;
+};
+
+#endif
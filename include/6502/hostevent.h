@@ -0,0 +1,42 @@
+#ifndef SIXFIVE_HOSTEVENT_H
+#define SIXFIVE_HOSTEVENT_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Something the host does to the machine from outside the guest program.
+/// Host events are queued from any thread and applied by the processor between
+/// two instructions, which is what makes them recordable and replayable.
+struct HostEvent {
+  enum class Kind : uint8_t {
+    /// Store \c value at \c addr, e.g. mouse coordinates into the IO page.
+    IO_WRITE,
+    /// Load \c image and reset the registers (hot reload).
+    RELOAD,
+    /// Stop running.
+    STOP,
+    /// The renderer finished a frame.
+    VSYNC,
+  };
+
+  Kind kind;
+  word_t addr = 0;
+  uint8_t value = 0;
+  /// The new memory image for RELOAD.
+  std::shared_ptr<const std::vector<uint8_t>> image;
+
+  static HostEvent io_write(word_t addr, uint8_t value) {
+    return {Kind::IO_WRITE, addr, value, nullptr};
+  }
+  static HostEvent reload(std::vector<uint8_t> image) {
+    return {Kind::RELOAD, 0, 0,
+            std::make_shared<const std::vector<uint8_t>>(std::move(image))};
+  }
+  static HostEvent stop() { return {Kind::STOP, 0, 0, nullptr}; }
+  static HostEvent vsync() { return {Kind::VSYNC, 0, 0, nullptr}; }
+};
+
+#endif
@@ -1,15 +1,55 @@
 #ifndef SIXFIVE_MICROPROCESSOR_H
 #define SIXFIVE_MICROPROCESSOR_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
 #include <vector>
 
 #include "6502/InstructionSet/address_space.h"
+#include "6502/InstructionSet/arithmetic.h"
+#include "6502/InstructionSet/fusions.h"
 #include "6502/InstructionSet/instrs.h"
+#include "6502/heatmap.h"
+#include "6502/hostevent.h"
+#include "6502/watchpoints.h"
+#include "Devices/audio.h"
+#include "Devices/console.h"
+#include "Devices/scheduler.h"
 
+class CallProfiler;
+class InputRecorder;
+class SampleRing;
+class Snapshot;
+class TimelineRecorder;
+
+/// Hit counts of conditional branch outcomes. See \c Processor::coverage.
+using BranchCoverage = std::array<uint8_t, 2 * ADDR_SPACE_SZ>;
+
+/// A 6502 and its devices running on a 64 KB address space.
+///
+/// This is the embedding API of libsfem, the \c sfem-core target, which
+/// doesn't depend on raylib. A host builds a processor on a memory image it
+/// owns, then drives it with \c run, \c step, \c run_until or \c call,
+/// reading and writing memory and registers between those calls. Processors
+/// share nothing, so any number can run on different threads of one process.
 class Processor {
-  std::vector<uint8_t> &RAM;
+  /// Ahead-of-time translated blocks operate directly on the machine state.
+  friend struct Recompiled;
+  /// The lockstep engine moves lane state in and out for its scalar fallback.
+  friend class BatchProcessor;
+  /// Saves and restores the whole machine state, using the dirty pages.
+  friend class Snapshot;
+
+  /// The 64 KB address space. Not owned; may be a \c SharedImage::View.
+  uint8_t *RAM;
 
   /// Program counter
   word_t PC;
@@ -43,22 +83,240 @@ class Processor {
   /// byte is always assumed to be 0x01.
   uint8_t SP;
 
-  /// The new memory which will be loaded in when this interrupt is serviced.
-  uint8_t *reset = nullptr;
+  /// Events posted by other threads, applied before the next instruction.
+  std::mutex host_lock;
+  std::vector<HostEvent> host_events;
+  std::atomic<bool> host_events_pending = false;
+  /// Signalled when an event is posted, for a CPU waiting on the host.
+  std::condition_variable host_wake;
+  /// Logs every applied host event when set.
+  InputRecorder *recorder = nullptr;
+  /// Follows calls and returns when set.
+  CallProfiler *profiler = nullptr;
+  /// Stores a frame at every vsync when set.
+  TimelineRecorder *timeline = nullptr;
+
+  /// The CPU whose undefined opcodes we run. Picks the specialization of the
+  /// interpreter once per \c execute, never per instruction.
+  CpuVariant variant;
+
+  /// Value of SP at which an RTS ends the run instead of returning. 0xFF for
+  /// the top-level routine, or the caller's SP during \c call.
+  uint8_t return_SP = 0xFF;
+
+  /// Guest clock. Keeps counting across resets.
+  uint64_t cycles = 0;
+  /// Instructions executed, each one of a superinstruction or loop idiom
+  /// included.
+  uint64_t retired = 0;
+  /// Frames and reloads the host has signalled.
+  uint64_t vsyncs = 0;
+  uint64_t reloads = 0;
+  /// Guest cycle of the last vsync. See \c FRAME_CYCLES.
+  uint64_t frame_start = 0;
+
+  /// Interrupt sources which fired and weren't acknowledged, and those which
+  /// may raise an IRQ. See Devices/interrupts.h.
+  uint8_t irq_pending = 0;
+  uint8_t irq_mask = 0;
+  /// Whether a pending source is enabled, i.e. the IRQ line is asserted.
+  bool irq_line = false;
+  /// Set by a write to \c IO::wait until a source in \c wait_mask is pending.
+  bool waiting = false;
+  uint8_t wait_mask = 0;
+  /// Pending device events. The CPU only looks at the earliest one.
+  DeviceScheduler scheduler;
+  /// Sound generator, and where its samples go. Without an output nothing is
+  /// generated.
+  AudioUnit audio;
+  SampleRing *audio_out = nullptr;
+  /// Text output of the guest.
+  Console console;
+
+  /// Breakpoints and watchpoints. See \c execute for how they are checked.
+  WatchList watches;
+  /// Page flag, next to the \c WatchKind bits, of the page with devices.
+  static constexpr uint8_t PAGE_IO = 1 << 7;
+  /// Page flag of a clean page while writes are tracked. The first write to
+  /// the page marks it dirty and clears the flag, so only that write takes
+  /// the slow path.
+  static constexpr uint8_t PAGE_TRACK = 1 << 6;
+  /// Per page, \c PAGE_IO, \c PAGE_TRACK and the kinds of watch touching it.
+  /// Writes to a flagged page take the slow path.
+  std::array<uint8_t, 256> page_flags{};
+  /// Pages written since tracking started, when \c tracking.
+  std::array<bool, 256> dirty{};
+  bool tracking = false;
+  /// The watch which stopped the last run.
+  std::optional<WatchHit> hit;
+  /// Set by a read or write hit, to stop once the instruction is done.
+  bool watch_stop = false;
+  /// PC of the breakpoint we stopped at, which resuming mustn't hit again.
+  uint32_t resume_PC = UINT32_MAX;
+
+#ifdef SFEM_HEATMAP
+  /// Memory traffic, counted by every access. Superinstructions and loop
+  /// idioms are off in these builds, since they don't go through the counters.
+  std::unique_ptr<AccessHeatmap> heat = std::make_unique<AccessHeatmap>();
+#endif
+#ifdef SFEM_COVERAGE
+  /// Hit counts of conditional branch outcomes, indexed by the address of the
+  /// branch times two plus whether it was taken. Wraps at 256.
+  std::unique_ptr<BranchCoverage> edges = std::make_unique<BranchCoverage>();
+#endif
+
+  /// How many times each superinstruction has fired.
+  std::array<uint64_t, NUM_FUSIONS> fusion_hits{};
+  /// How many fill and copy loops were run as a single host operation.
+  uint64_t fill_loops = 0;
+  uint64_t copy_loops = 0;
 
  public:
-  Processor(std::vector<uint8_t> &mem) : RAM(mem) { reset_internal_state(); };
+  Processor(uint8_t *mem, CpuVariant variant = CpuVariant::NMOS)
+      : RAM(mem), variant(variant) {
+    reset_internal_state();
+    update_page_flags();
+  };
+  Processor(std::vector<uint8_t> &mem, CpuVariant variant = CpuVariant::NMOS)
+      : Processor(mem.data(), variant) {}
+
+  /// Guest cycles in a frame, at the nominal clock rate of
+  /// \c AudioUnit::CLOCK_HZ and 60 frames per second. The guest clock stands
+  /// still in a wait only the host can end, so a guest which sleeps until
+  /// vsync is moved on to one frame after the previous vsync when it comes.
+  /// Its time, and so its sound, then keeps pace with the frames.
+  static constexpr uint64_t FRAME_CYCLES = AudioUnit::CLOCK_HZ / 60;
 
   /// Run code until completion. \return the final value of the accumulator
   /// register. Interruptible.
   uint8_t run();
 
-  /// Set by another thread when we should reset. This contains the pointer
-  /// where we can find the new memory to copy into RAM.
-  void set_reset(uint8_t *new_mem) { reset = new_mem; }
+  /// Execute up to \p steps instructions, one at a time, not counting time
+  /// spent waiting. \return false once the top-level routine has returned,
+  /// at which point PC still points at its final RTS, or the host stopped us.
+  /// Returns early, still waiting, at a wait only the host can end.
+  bool step(uint64_t steps = 1) { return execute(steps, UINT64_MAX, false); }
+
+  /// Run until the guest clock reaches \p cycle, stopping at the first
+  /// instruction boundary at or past it. \return false as \c step does, and
+  /// returns early as it does.
+  bool run_until(uint64_t cycle) {
+    return execute(UINT64_MAX, cycle, false);
+  }
+
+  /// Sleep until the host posts an event, for hosts driving the processor
+  /// with \c step or \c run_until when they return early.
+  void wait_for_host();
+
+  /// Call the guest subroutine at \p addr with \p a, \p x and \p y in the
+  /// accumulator and index registers, until its matching RTS. The routine
+  /// runs on the stack below the current SP, and every register is restored
+  /// afterwards, so this can be used between steps of a running program.
+  /// \return the accumulator at the RTS, or nothing if the routine didn't get
+  /// there: a watch or the host stopped it, or it waits for the host.
+  std::optional<uint8_t> call(word_t addr, uint8_t a = 0, uint8_t x = 0,
+                              uint8_t y = 0);
+
+  /// Snapshot of the registers, for hosts to inspect or change.
+  struct Registers {
+    word_t PC;
+    uint8_t AC;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t SR;
+    uint8_t SP;
+  };
+  Registers registers() const { return {PC, AC, X, Y, SR, SP}; }
+  void set_registers(const Registers &regs) {
+    PC = regs.PC;
+    AC = regs.AC;
+    X = regs.X;
+    Y = regs.Y;
+    *reinterpret_cast<uint8_t *>(&SR) = regs.SR;
+    SP = regs.SP;
+  }
+
+  /// Stop before the instruction at \p pc. \return an id for
+  /// \c remove_watch.
+  int add_breakpoint(word_t pc) { return add_watch(pc, pc, WATCH_EXEC); }
+  /// Stop when the guest accesses an address from \p first to \p last
+  /// inclusive in one of the \c WatchKind ways in \p kinds. Execution stops
+  /// before an instruction on an exec watch, and after the instruction which
+  /// read or wrote otherwise. Reads are the operands of instructions; stack
+  /// pops, and devices writing memory, aren't watched. \return an id for
+  /// \c remove_watch.
+  int add_watch(word_t first, word_t last, uint8_t kinds) {
+    int id = watches.add(first, last, kinds);
+    update_page_flags();
+    return id;
+  }
+  void remove_watch(int id) {
+    watches.remove(id);
+    update_page_flags();
+  }
+  void clear_watches() {
+    watches.clear();
+    update_page_flags();
+  }
+  /// The watch which made the last \c step, \c run_until or \c run return,
+  /// if one did. Set watches only while the processor isn't running.
+  const std::optional<WatchHit> &watch_hit() const { return hit; }
+
+  /// Queue \p event from any thread. It's applied before the next instruction.
+  void post(HostEvent event);
+
+  /// Log every host event to \p rec as it is applied. Call before running.
+  void record_to(InputRecorder *rec) { recorder = rec; }
+
+  /// Report every call, interrupt and return to \p prof. Call before running.
+  /// Blocks of \c sfem_add_recompiled_rom() binaries aren't followed.
+  void profile_to(CallProfiler *prof) { profiler = prof; }
+
+  /// Store the current state in \p tl, and again at every vsync. Call
+  /// before running.
+  void timeline_to(TimelineRecorder *tl);
+
+  /// Send the guest's console text to \p fd rather than standard output, or
+  /// nowhere for -1. Call while not running.
+  void console_to(int fd) { console.set_output(fd); }
+
+  /// Generate sound into \p ring, from the current guest cycle on. Call
+  /// before running. See Devices/audio.h.
+  void audio_to(SampleRing *ring) {
+    audio_out = ring;
+    audio.reset(cycles);
+    audio.latch(RAM);
+    schedule_audio();
+  }
+
+  /// The address space. Hosts may read and write it between runs; writes to
+  /// the IO page this way don't reach the devices.
+  const uint8_t *memory() const { return RAM; }
+  uint8_t *memory() { return RAM; }
 
-  const std::vector<uint8_t> &memory() const { return RAM; }
-  std::vector<uint8_t> &memory() { return RAM; }
+  /// Number of guest cycles executed so far.
+  uint64_t cycle_count() const { return cycles; }
+  /// Number of guest instructions executed so far.
+  uint64_t instruction_count() const { return retired; }
+  /// Number of vsync and reload events applied so far.
+  uint64_t vsync_count() const { return vsyncs; }
+  uint64_t reload_count() const { return reloads; }
+
+  const std::array<uint64_t, NUM_FUSIONS> &fusion_stats() const {
+    return fusion_hits;
+  }
+#ifdef SFEM_HEATMAP
+  const AccessHeatmap &heatmap() const { return *heat; }
+  AccessHeatmap &heatmap() { return *heat; }
+#endif
+#ifdef SFEM_COVERAGE
+  /// Branch outcomes seen so far. Hosts clear it between runs.
+  const BranchCoverage &coverage() const { return *edges; }
+  BranchCoverage &coverage() { return *edges; }
+#endif
+
+  /// Print how often each superinstruction and loop idiom fired.
+  void print_dispatch_stats(std::ostream &os) const;
 
  private:
   /// Read a single byte from anywhere memory.
@@ -72,8 +330,82 @@ class Processor {
     return (word_t)RAM[addr] | ((word_t)RAM[addr + 1] << 8);
   }
 
-  /// Write a single byte to memory.
-  inline void write(word_t addr, uint8_t data) { RAM[addr] = data; }
+  /// Write a single byte to memory. Writes to the IO page are also seen by
+  /// the device mapped there.
+  inline void write(word_t addr, uint8_t data) {
+    RAM[addr] = data;
+#ifdef SFEM_HEATMAP
+    AccessHeatmap::count(heat->writes, addr);
+#endif
+    if (page_flags[addr >> 8]) flagged_write(addr, data);
+  }
+  /// Write side effects for a page with flags: devices and write watches.
+  void flagged_write(word_t addr, uint8_t data);
+  /// Read the operand at \p addr, checking read watches when \p WATCH.
+  template <bool WATCH>
+  inline uint8_t load(word_t addr) {
+    if constexpr (WATCH) {
+      if (page_flags[addr >> 8] & WATCH_READ &&
+          watches.matches(addr, WATCH_READ)) {
+        watch_hit_at(WATCH_READ, addr);
+      }
+    }
+#ifdef SFEM_HEATMAP
+    AccessHeatmap::count(heat->reads, addr);
+#endif
+    return RAM[addr];
+  }
+  /// Record a hit of \p kind at \p addr by the current instruction.
+  void watch_hit_at(WatchKind kind, word_t addr) {
+    hit = WatchHit{kind, addr, PC, cycles};
+    watch_stop = true;
+  }
+  void update_page_flags() {
+    page_flags = watches.pages();
+    page_flags[Regions::IO.begin >> 8] |= PAGE_IO;
+    if (!tracking) return;
+    for (size_t page = 0; page < page_flags.size(); page++) {
+      if (!dirty[page]) page_flags[page] |= PAGE_TRACK;
+    }
+  }
+  /// Mark the pages of [\p addr, \p addr + \p len) dirty, for writes which
+  /// don't go through \c write. Wraps around the end of memory.
+  void mark_dirty(word_t addr, uint32_t len) {
+    if (!tracking || len == 0) return;
+    uint32_t pages = std::min<uint32_t>(
+        ((addr & (PAGE_SZ - 1)) + len + PAGE_SZ - 1) / PAGE_SZ, 256);
+    for (uint32_t i = 0; i < pages; i++) {
+      uint8_t page = (addr >> 8) + i;
+      dirty[page] = true;
+      page_flags[page] &= ~PAGE_TRACK;
+    }
+  }
+  /// Let the device at \p addr react to \p data having been written.
+  void io_write(word_t addr, uint8_t data);
+
+  /// Mark \p sources pending and update the IRQ line.
+  void raise_irq(uint8_t sources);
+  /// Push PC and the status register and jump through \c IRQ_VECTOR.
+  void enter_irq();
+  /// Service every device event due by now.
+  void run_devices();
+  /// Fire the timer, which was due at \p due, and schedule its next deadline.
+  void run_timer(uint64_t due);
+  /// Push the sound generated so far, and schedule the next push.
+  void run_audio();
+  void schedule_audio() {
+    if (audio_out) {
+      scheduler.schedule(DeviceEvent::AUDIO,
+                         cycles + AudioUnit::FLUSH_CYCLES);
+    }
+  }
+  /// Spend time in a wait until something can end it, at most until
+  /// \p until_cycle. A timer which can end the wait is reached by advancing
+  /// the guest clock. Otherwise only the host can: with \p block the thread
+  /// sleeps until an event is posted, else this \return false at once.
+  bool idle(uint64_t until_cycle, bool block);
+  /// Whether the timer will end the current wait, as opposed to the host.
+  bool timer_ends_wait() const;
 
   /// Push \p val to the stack. Decrements \c SP.
   inline void push(uint8_t val) {
@@ -82,12 +414,86 @@ class Processor {
   }
   /// Pop and \return the top value from the stack. Increments \c SP.
   inline uint8_t pop() {
-    auto ret = read(Regions::STACK.begin | SP + 1);
+#ifdef SFEM_HEATMAP
+    AccessHeatmap::count(heat->reads, Regions::STACK.begin | (SP + 1));
+#endif
+    auto ret = read(Regions::STACK.begin | (SP + 1));
     ++SP;
     return ret;
   }
 
-  void check_for_interrupts();
+  /// Commit a packed \c ArithTables entry: the low byte becomes the new
+  /// accumulator and the high byte replaces the C, Z, V and N flags.
+  inline void apply_arith(uint16_t entry) {
+    AC = entry & 0xFF;
+    uint8_t &sr = *reinterpret_cast<uint8_t *>(&SR);
+    sr = (sr & ~ArithTables::FLAGS_MASK) | (entry >> 8);
+  }
+
+  /// \return whether \p a and \p b lie on different pages.
+  static inline bool crosses_page(word_t a, word_t b) {
+    return (a ^ b) & 0xFF00;
+  }
+
+  /// Take the relative branch at \p at when \p taken, otherwise fall through
+  /// to the instruction after it. A taken branch costs one extra cycle, two if
+  /// it lands on another page.
+  inline void branch(bool taken, word_t at) {
+    PC = at + 2;
+#ifdef SFEM_COVERAGE
+    ++(*edges)[at << 1 | taken];
+#endif
+    if (!taken) return;
+    word_t target = PC + (int8_t)read(at + 1);
+    cycles += 1 + crosses_page(PC, target);
+    PC = target;
+  }
+
+  /// \return the superinstruction starting at PC, or \c Fusion::NONE.
+  Fusion match_fusion();
+  /// Execute the whole sequence covered by \p fused and advance PC past it.
+  void run_fused(Fusion fused);
+  /// Run a fill or copy loop starting at PC with a single host memset or
+  /// memmove. \return false, without touching any state, when the code at PC
+  /// isn't such a loop or when it can't be run safely in one go.
+  bool run_loop_idiom();
+
+  /// Run due devices, apply pending host events and take a pending IRQ.
+  /// \return false if a host event asked us to stop.
+  inline bool check_for_interrupts() {
+    if (cycles >= scheduler.next()) run_devices();
+    if (host_events_pending.load(std::memory_order_relaxed) &&
+        !apply_host_events()) {
+      return false;
+    }
+    if (irq_line && !SR.I) enter_irq();
+    return true;
+  }
+  bool apply_host_events();
+
+  /// The interpreter loop behind \c step and \c run_until. Runs the
+  /// \c interpret specialized for \c variant, without watch checks unless
+  /// watches are set, so they cost nothing until then. Waits only the host
+  /// can end make it return, unless \p block.
+  bool execute(uint64_t steps, uint64_t until_cycle, bool block);
+  /// The interpreter loop proper, decoding with \p CPU's instruction table.
+  /// With \p WATCH, it checks watches and stops at hits, and doesn't use
+  /// superinstructions or loop idioms, which access memory behind the checks'
+  /// back. Nor does it with a bounded \p steps, which counts instructions.
+  template <CpuVariant CPU, bool WATCH>
+  bool interpret(uint64_t steps, uint64_t until_cycle, bool block);
+
+  /// Run \p desc, an instruction outside the documented set, and advance PC
+  /// past it. Off the hot path: the interpreter only gets here from its
+  /// default case. See variants.cpp. \return false if it's invalid on the
+  /// variant too.
+  template <bool WATCH>
+  bool run_undocumented(const InstDesc &desc);
+  template <bool WATCH>
+  bool run_65c02(const InstDesc &desc);
+  /// Effective address of the operand of \p desc, for immediates the address
+  /// of the operand byte. Adds the page crossing penalty.
+  word_t operand_address(const InstDesc &desc);
 
   void reset_internal_state() {
     PC = Regions::BOOTLOADER_ADDR;
@@ -96,7 +502,16 @@ class Processor {
     Y = 0;
     // Starts high and grows towards 0.
     SP = 0xFF;
+    return_SP = 0xFF;
     memset(&SR, 0, sizeof(StatusRegister));
+    irq_pending = 0;
+    irq_mask = 0;
+    irq_line = false;
+    waiting = false;
+    scheduler.clear();
+    schedule_audio();
+    // Nothing is scheduled to flush text written before, so do it now.
+    console.hand_off();
   }
 };
 
@@ -0,0 +1,92 @@
+#ifndef SIXFIVE_PROFILER_H
+#define SIXFIVE_PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+
+/// Guest cycles spent in each routine, and in each chain of calls reaching
+/// it, from a shadow call stack which follows JSR, RTS, interrupts and RTI.
+/// Attach one to a processor with \c Processor::profile_to.
+///
+/// Each frame remembers the stack pointer at which its return address sits.
+/// A return pops the frame whose return address it pops, along with any
+/// frames above it, whose return addresses the guest dropped from the stack.
+/// A return matching no frame, like an RTS used to jump through an address
+/// the guest pushed, leaves the stack alone. A call first drops frames whose
+/// return addresses the stack pointer has moved past, as after a TXS which
+/// resets the stack. Routines are known by their entry address, and by a
+/// name when labels are loaded.
+class CallProfiler {
+ public:
+  /// Start in the routine at \p root, \p now being the guest clock.
+  explicit CallProfiler(word_t root = Regions::BOOTLOADER_ADDR,
+                        uint64_t now = 0);
+
+  /// Name routines after the labels in \p path, in the format of ld65's -Ln
+  /// option ("al 000600 .name" lines). \return false if it can't be read.
+  bool load_labels(const std::string &path);
+
+  /// A call to \p addr, after which the stack pointer is \p sp.
+  void enter(word_t addr, uint8_t sp, uint64_t now);
+  /// A return which pops its address starting at the stack pointer \p sp.
+  void leave(uint8_t sp, uint64_t now);
+  /// Return from every open routine, ending the profile at \p now.
+  void finish(uint64_t now);
+
+  struct RoutineStats {
+    uint64_t calls = 0;
+    /// Cycles from entry to return, counted once through recursion.
+    uint64_t inclusive = 0;
+    /// Cycles spent in the routine itself, not in routines it called.
+    uint64_t exclusive = 0;
+  };
+  const RoutineStats &stats(word_t addr) const { return routines[addr]; }
+
+  /// Write one line per call chain, outermost routine first, with the
+  /// exclusive cycles of its last routine: "main;game_draw;clear 1234". This
+  /// is the collapsed stack format of flamegraph.pl and similar tools.
+  void write_collapsed(std::ostream &os) const;
+  /// Print the \p top routines by inclusive cycles. Routines still running
+  /// haven't been given their inclusive cycles yet; see \c finish.
+  void print_summary(std::ostream &os, size_t top = 20) const;
+
+  std::string name(word_t addr) const;
+
+ private:
+  /// A distinct chain of calls.
+  struct Node {
+    word_t addr;
+    uint32_t parent;
+    uint64_t exclusive = 0;
+  };
+  struct Frame {
+    uint32_t node;
+    word_t addr;
+    /// Stack pointer just after the call, 0x100 for the root.
+    uint16_t sp;
+    uint64_t start;
+  };
+
+  /// Give the cycles since the last event to the routine on top.
+  void charge(uint64_t now);
+  void pop(uint64_t now);
+  uint32_t child(uint32_t parent, word_t addr);
+
+  std::vector<Node> nodes;
+  /// Node index by (parent node << 16 | routine address).
+  std::unordered_map<uint64_t, uint32_t> children;
+  std::vector<Frame> frames;
+  uint64_t last = 0;
+
+  std::vector<RoutineStats> routines;
+  /// Frames of each routine on the stack, so recursion counts once.
+  std::vector<uint32_t> depth;
+  std::unordered_map<word_t, std::string> labels;
+};
+
+#endif
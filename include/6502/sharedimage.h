@@ -0,0 +1,48 @@
+#ifndef SIXFIVE_SHAREDIMAGE_H
+#define SIXFIVE_SHAREDIMAGE_H
+
+#include <cstdint>
+#include <vector>
+
+/// A 64 KB image which any number of processors can use as their memory
+/// without each paying for a full copy.
+///
+/// The image lives in an anonymous in-memory file. Every \c View maps it
+/// privately, so the kernel shares the physical pages between all views and
+/// copies a page for a view only on that view's first write to it. Sharing is
+/// at the host page size (4 KB, sixteen guest pages), and reads never copy.
+class SharedImage {
+ public:
+  explicit SharedImage(const std::vector<uint8_t>& image);
+  ~SharedImage();
+
+  SharedImage(const SharedImage&) = delete;
+  SharedImage& operator=(const SharedImage&) = delete;
+
+  /// False if the backing file couldn't be created.
+  bool valid() const { return fd >= 0; }
+
+  /// One processor's copy-on-write mapping of the image.
+  class View {
+   public:
+    explicit View(const SharedImage& image);
+    ~View();
+
+    View(View&& other) noexcept;
+    View& operator=(View&& other) noexcept;
+    View(const View&) = delete;
+    View& operator=(const View&) = delete;
+
+    /// Start of the 64 KB address space, or nullptr if mapping failed.
+    uint8_t* data() { return mem; }
+    const uint8_t* data() const { return mem; }
+
+   private:
+    uint8_t* mem = nullptr;
+  };
+
+ private:
+  int fd = -1;
+};
+
+#endif
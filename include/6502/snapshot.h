@@ -0,0 +1,68 @@
+#ifndef SIXFIVE_SNAPSHOT_H
+#define SIXFIVE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "6502/processor.h"
+
+/// A saved state of a processor, which it can be put back to cheaply and
+/// repeatedly, as a fuzzer does between runs.
+///
+/// Taking a snapshot copies memory once and makes the processor track the
+/// pages written from then on. Restoring copies back only those pages, plus
+/// the IO page, which devices write directly, along with the registers, the
+/// guest clock, the instruction, vsync and reload counts, the interrupt and
+/// wait state, pending device events, the sound generator and the console
+/// text not yet handed off. Hosts which write \c memory() themselves after
+/// the snapshot must say so with \c touch.
+///
+/// What already left the machine stays out: samples pushed to the audio
+/// output and console text handed off aren't taken back. Watches, the dispatch
+/// counters, the heatmap and branch coverage aren't part of the state, and
+/// keep counting across restores.
+class Snapshot {
+ public:
+  explicit Snapshot(Processor &proc);
+  /// Stops tracking writes.
+  ~Snapshot();
+
+  Snapshot(const Snapshot &) = delete;
+  Snapshot &operator=(const Snapshot &) = delete;
+
+  /// Put the processor back to the state it was in when the snapshot was
+  /// taken. Call while it isn't running.
+  void restore();
+
+  /// Note that the host wrote [\p addr, \p addr + \p len) of \c memory().
+  void touch(word_t addr, uint32_t len) { proc.mark_dirty(addr, len); }
+
+  /// Pages copied by the last \c restore.
+  size_t pages_restored() const { return restored; }
+
+ private:
+  Processor &proc;
+  std::vector<uint8_t> memory;
+
+  Processor::Registers regs;
+  uint8_t return_SP;
+  uint64_t cycles;
+  uint64_t retired;
+  uint64_t vsyncs;
+  uint64_t reloads;
+  uint64_t frame_start;
+  uint8_t irq_pending;
+  uint8_t irq_mask;
+  bool irq_line;
+  bool waiting;
+  uint8_t wait_mask;
+  DeviceScheduler scheduler;
+  AudioUnit audio;
+  std::string console_text;
+
+  size_t restored = 0;
+};
+
+#endif
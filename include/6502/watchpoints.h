@@ -0,0 +1,61 @@
+#ifndef SIXFIVE_WATCHPOINTS_H
+#define SIXFIVE_WATCHPOINTS_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Accesses a watch can stop on. Bits, so a watch can combine them.
+enum WatchKind : uint8_t {
+  WATCH_READ = 1 << 0,
+  WATCH_WRITE = 1 << 1,
+  /// An instruction starting in the range. A one-byte exec watch is a
+  /// breakpoint.
+  WATCH_EXEC = 1 << 2,
+};
+
+/// Where and why a watch stopped the processor.
+struct WatchHit {
+  WatchKind kind;
+  /// The address accessed. For \c WATCH_EXEC the same as \c PC.
+  word_t addr;
+  /// The instruction which made the access.
+  word_t PC;
+  /// Guest clock at the hit.
+  uint64_t cycle;
+};
+
+/// The breakpoints and watchpoints set on a processor, together with a
+/// summary of which kinds of watch touch each page. Only accesses to a page
+/// with a matching flag need their ranges checked.
+class WatchList {
+ public:
+  /// Watch the addresses from \p first to \p last inclusive for the
+  /// \c WatchKind bits in \p kinds. \return an id for \c remove.
+  int add(word_t first, word_t last, uint8_t kinds);
+  void remove(int id);
+  void clear();
+
+  bool empty() const { return active == 0; }
+  /// \c WatchKind bits of the watches touching \p page.
+  const std::array<uint8_t, 256>& pages() const { return page_kinds; }
+  /// \return whether any watch for \p kind covers \p addr.
+  bool matches(word_t addr, WatchKind kind) const;
+
+ private:
+  struct Watch {
+    word_t first;
+    word_t last;
+    /// 0 once removed, so ids stay stable.
+    uint8_t kinds;
+  };
+  std::vector<Watch> watches;
+  size_t active = 0;
+  std::array<uint8_t, 256> page_kinds{};
+
+  void rebuild_pages();
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DEVICES_AUDIO_H
+#define DEVICES_AUDIO_H
+
+#include <array>
+#include <cstdint>
+
+#include "6502/InstructionSet/address_space.h"
+
+class SampleRing;
+
+/// Memory mapped sound generator: two square wave channels, a noise channel
+/// and an 8 bit DAC, mixed into one mono stream.
+///
+/// Pitches are given in guest cycles, so the sound is tied to the guest clock
+/// rather than to the host's: samples are taken every
+/// \c CLOCK_HZ / \c SAMPLE_RATE guest cycles. Register writes take effect at
+/// the exact cycle of the write, as everything up to it is rendered with the
+/// old values first, which also makes the DAC usable for sample playback.
+class AudioUnit {
+ public:
+  /// Guest clock rate the output is timed against. The emulator doesn't
+  /// throttle the guest, so this is only the ratio of cycles to samples.
+  static constexpr uint64_t CLOCK_HZ = 1000000;
+  static constexpr uint32_t SAMPLE_RATE = 44100;
+  /// Guest cycles between renders when the guest doesn't touch the registers,
+  /// which bounds the latency of the output.
+  static constexpr uint64_t FLUSH_CYCLES = CLOCK_HZ / 100;
+  /// Number of registers from \c IO::audio_square0_period.
+  static constexpr word_t NUM_REGS = 16;
+
+  /// Start the output at guest cycle \p now, with every channel silent.
+  void reset(uint64_t now);
+  /// Push the samples due up to guest cycle \p now to \p ring.
+  void render(uint64_t now, SampleRing& ring);
+  /// Take the register values from \p mem, for the cycles after the last
+  /// render.
+  void latch(const uint8_t* mem);
+
+ private:
+  struct Square {
+    /// Position within the wave, counting up to twice the period.
+    uint32_t phase = 0;
+  };
+
+  /// Register values in effect, relative to \c IO::audio_square0_period.
+  std::array<uint8_t, NUM_REGS> regs{};
+  std::array<Square, 2> squares;
+  /// Cycles into the current noise step, and the 15 bit shift register.
+  uint32_t noise_phase = 0;
+  uint16_t lfsr = 1;
+
+  /// Cycle the channels have been run up to.
+  uint64_t clock = 0;
+  /// Cycle the output started at, and samples produced since.
+  uint64_t origin = 0;
+  uint64_t emitted = 0;
+
+  word_t reg_word(word_t addr) const;
+  /// Run the channels for \p cycles.
+  void advance(uint64_t cycles);
+  int16_t mix() const;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DEVICES_BLITTER_H
+#define DEVICES_BLITTER_H
+
+#include <cstdint>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Commands understood by the blitter's command register.
+enum class BlitOp : uint8_t {
+  NONE = 0,
+  /// Set every destination byte to the fill register.
+  FILL = 1,
+  /// Copy the source rectangle to the destination.
+  COPY = 2,
+  /// OR the source rectangle into the destination.
+  OR = 3,
+};
+
+/// Memory mapped block transfer engine.
+///
+/// The guest sets up the registers in \c IO (source, destination, width,
+/// height, strides and fill byte) and then writes a \c BlitOp to
+/// \c IO::blit_cmd. The whole operation happens on that write, while the CPU
+/// is stalled for the cycles it costs. A byte range is a rectangle of one row.
+/// Rows are processed top to bottom, and addresses wrap around the end of
+/// memory. The blitter writes memory directly, so it never triggers devices
+/// even when the destination is the IO page.
+class Blitter {
+ public:
+  /// Fixed cost of decoding a command.
+  static constexpr uint64_t SETUP_CYCLES = 4;
+  /// Cost per destination byte of a fill, which only writes.
+  static constexpr uint64_t FILL_CYCLES = 1;
+  /// Cost per destination byte of a copy or OR, which read and write.
+  static constexpr uint64_t COPY_CYCLES = 2;
+
+  /// Run \p op on \p mem using the parameters in the blitter registers, and
+  /// store its cost in \c IO::blit_cost. \return the guest cycles it took.
+  static uint64_t run(uint8_t* mem, uint8_t op);
+
+  /// First address the registers in \p mem make a command write.
+  static word_t destination(const uint8_t* mem);
+  /// How many bytes from \c destination a command may write, gaps between
+  /// rows included.
+  static uint32_t extent(const uint8_t* mem);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef DEVICES_CONSOLE_H
+#define DEVICES_CONSOLE_H
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Memory mapped text output for guest logging.
+///
+/// Each register formats the byte written to it: as a character, in hex, in
+/// unsigned or signed decimal, or as 8 binary digits. A write to
+/// \c IO::console_flush asks for the text so far to be written out now.
+/// Text is gathered in a buffer owned by the CPU thread and handed to a
+/// writer thread once it's large, when \c FLUSH_CYCLES have passed since its
+/// first byte, or when the guest stops or waits for the host. So a write
+/// costs the CPU a few stores, never a system call.
+class Console {
+ public:
+  /// Number of registers from \c IO::console_char.
+  static constexpr word_t NUM_REGS = 8;
+  /// Guest cycles text may wait in the buffer.
+  static constexpr uint64_t FLUSH_CYCLES = 1 << 16;
+  /// Buffer size at which text is handed off right away.
+  static constexpr size_t HANDOFF_BYTES = 4096;
+
+  /// Write text to \p fd, which stays open; -1 discards it.
+  explicit Console(int fd = STDOUT_FILENO) : fd(fd) {}
+  /// Writes out the text handed off and waits for it.
+  ~Console();
+
+  Console(const Console&) = delete;
+  Console& operator=(const Console&) = delete;
+
+  /// Change where text goes. Only while the processor isn't running.
+  void set_output(int out) { fd = out; }
+
+  /// Handle a write of \p value to the register at \p addr. \return whether
+  /// it started an empty buffer, in which case a \c hand_off must follow
+  /// within \c FLUSH_CYCLES.
+  bool write(word_t addr, uint8_t value);
+  /// Pass the buffer to the writer thread, started on first use.
+  void hand_off();
+
+  /// Text written but not yet handed off, which snapshots save and put back.
+  const std::string& pending() const { return buffer; }
+  void set_pending(const std::string& text) { buffer = text; }
+
+ private:
+  int fd;
+  /// Text of the CPU thread, not yet handed off.
+  std::string buffer;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  /// Text handed off, waiting for the writer thread.
+  std::string queued;
+  bool stopping = false;
+  std::thread writer;
+
+  void write_loop();
+};
+
+#endif
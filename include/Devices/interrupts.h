@@ -0,0 +1,29 @@
+#ifndef DEVICES_INTERRUPTS_H
+#define DEVICES_INTERRUPTS_H
+
+#include <cstdint>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Interrupt sources. Each one is a bit of \c IO::irq_status, \c IO::irq_enable
+/// and of the mask written to \c IO::wait.
+enum IrqSource : uint8_t {
+  /// The timer reached the end of its period.
+  IRQ_TIMER = 1 << 0,
+  /// The renderer finished a frame.
+  IRQ_VSYNC = 1 << 1,
+};
+
+/// Bits of \c IO::timer_ctrl.
+enum TimerControl : uint8_t {
+  /// Count down \c IO::timer_period guest cycles, fire, and start over.
+  TIMER_RUN = 1 << 0,
+};
+
+/// Where the IRQ handler's address is read from.
+static constexpr word_t IRQ_VECTOR = 0xFFFE;
+
+/// Cycles spent pushing PC and the status register and jumping to the handler.
+static constexpr uint8_t IRQ_CYCLES = 7;
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef DEVICES_MATHUNIT_H
+#define DEVICES_MATHUNIT_H
+
+#include <cstdint>
+
+/// Commands understood by the math unit's operation register. The catalogue,
+/// with the latency of each operation, lives in mathops.def.
+enum class MathOp : uint8_t {
+  NONE = 0,
+#define MATH_OP(name, code, latency) name = code,
+#include "Devices/mathops.def"
+};
+
+/// Bits of \c IO::math_status.
+enum MathStatus : uint8_t {
+  /// The divisor was 0. The quotient is all ones, the remainder the dividend.
+  MATH_DIV_ZERO = 1 << 0,
+  /// A signed 16 bit result didn't fit. The low word holds it truncated.
+  MATH_OVERFLOW = 1 << 1,
+};
+
+/// Memory mapped multiply/divide coprocessor.
+///
+/// The guest writes operands to \c IO::math_a and \c IO::math_b and then an
+/// operation to \c IO::math_op. The CPU is stalled for the operation's
+/// latency, after which the result, remainder and status registers hold the
+/// answer. The result register is 32 bits wide so that full products fit;
+/// 8 bit operands use the low byte of each operand register.
+class MathUnit {
+ public:
+  /// Guest cycles \p op keeps the CPU waiting. 0 for unknown operations,
+  /// which are ignored.
+  static constexpr uint64_t latency(MathOp op) {
+    switch (op) {
+#define MATH_OP(name, code, latency) \
+  case MathOp::name:                 \
+    return latency;
+#include "Devices/mathops.def"
+      default:
+        return 0;
+    }
+  }
+
+  /// Run \p op on the operands in \p mem and store its results there.
+  /// \return the guest cycles it took.
+  static uint64_t run(uint8_t* mem, uint8_t op);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef DEVICES_SCHEDULER_H
+#define DEVICES_SCHEDULER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Things devices ask to happen at a given guest cycle.
+enum class DeviceEvent : uint8_t {
+  /// The timer reaches the end of its period.
+  TIMER,
+  /// Sound generated so far is pushed to the output.
+  AUDIO,
+  /// Console text has waited long enough and is handed off.
+  CONSOLE,
+  NUM_EVENTS,
+};
+
+/// Orders pending device events by the guest cycle they are due at.
+///
+/// The CPU only compares its clock against \c next() before each instruction,
+/// however many devices there are. Once it is reached, the due events are
+/// popped in order and serviced; nothing else is looked at. Each event is
+/// scheduled at most once: scheduling it again moves it. Moved and cancelled
+/// entries are left in the heap and skipped when they come up.
+class DeviceScheduler {
+ public:
+  DeviceScheduler() { clear(); }
+
+  /// Guest cycle of the earliest event, or UINT64_MAX with none scheduled.
+  uint64_t next() const { return next_deadline; }
+  /// When \p event is due, or UINT64_MAX if it isn't scheduled.
+  uint64_t deadline(DeviceEvent event) const {
+    return deadlines[(size_t)event];
+  }
+
+  /// Make \p event due at \p cycle, replacing any earlier schedule.
+  void schedule(DeviceEvent event, uint64_t cycle);
+  void cancel(DeviceEvent event);
+  void clear();
+
+  /// Unschedule the earliest event if it is due at or before \p now, and store
+  /// it in \p event and its deadline in \p due. \return false if none is due.
+  bool pop_due(uint64_t now, DeviceEvent& event, uint64_t& due);
+
+ private:
+  static constexpr size_t NUM_EVENTS = (size_t)DeviceEvent::NUM_EVENTS;
+
+  struct Entry {
+    uint64_t cycle;
+    /// Matches \c generations of the event while the entry is current.
+    uint32_t generation;
+    DeviceEvent event;
+  };
+  /// Min-heap on cycle.
+  std::vector<Entry> heap;
+  std::array<uint32_t, NUM_EVENTS> generations{};
+  std::array<uint64_t, NUM_EVENTS> deadlines;
+  uint64_t next_deadline = UINT64_MAX;
+
+  /// Drop stale entries from the top and update \c next_deadline.
+  void settle();
+};
+
+#endif
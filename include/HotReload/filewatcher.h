@@ -1,11 +1,77 @@
 #ifndef HOTRELOAD_FILEWATCHER_H
 #define HOTRELOAD_FILEWATCHER_H
 
+#include <chrono>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 
+/// Watches any number of files and directories from one thread.
+///
+/// All watches share one inotify instance, multiplexed with a stop signal
+/// over epoll, so a single \c run loop can serve hundreds of machines. The
+/// directory containing a watched file is what's actually watched, so a file
+/// replaced by a rename, as editors that save atomically do, is still seen.
+/// Changes are debounced: a callback runs once the path has been quiet for
+/// the debounce delay, however many writes the burst had. Editor temporary
+/// files (swap files, backups, lock files) never trigger anything.
 class FileWatcher {
  public:
-  FileWatcher(const char* fpath, std::function<void()> onChange);
+  explicit FileWatcher(
+      std::chrono::milliseconds debounce = std::chrono::milliseconds(50));
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  /// False if the inotify or epoll instance couldn't be created.
+  bool valid() const { return epoll_fd >= 0; }
+
+  /// Call \p on_change from the \c run thread after \p path changes. For a
+  /// directory, a change to any file in it counts. May be called from any
+  /// thread, while \c run is going. \return an id for \c unwatch, or -1 if
+  /// \p path can't be watched.
+  int watch(const std::string& path, std::function<void()> on_change);
+  void unwatch(int id);
+
+  /// Wait for changes and run their callbacks until \c stop is called.
+  void run();
+  /// Make \c run return. Safe from any thread, including callbacks.
+  void stop();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Subscription {
+    /// inotify watch of the directory.
+    int wd;
+    /// File within the directory, or empty to match every file.
+    std::string name;
+    std::function<void()> on_change;
+  };
+
+  std::chrono::milliseconds debounce;
+  int inotify_fd = -1;
+  int epoll_fd = -1;
+  /// eventfd written by \c stop.
+  int stop_fd = -1;
+
+  std::mutex lock;
+  int next_id = 0;
+  std::map<int, Subscription> subscriptions;
+  /// Subscription ids by inotify watch.
+  std::map<int, std::vector<int>> by_watch;
+  /// When each changed subscription's callback is due.
+  std::map<int, Clock::time_point> pending;
+
+  /// Read every queued inotify event and (re)start the debounce of the
+  /// subscriptions they match.
+  void drain();
+  /// Run the callbacks whose debounce ran out. \return the time until the
+  /// next one is due, in ms, or -1 if none is pending.
+  int fire_due();
 };
 
 #endif
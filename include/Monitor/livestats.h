@@ -0,0 +1,93 @@
+#ifndef MONITOR_LIVESTATS_H
+#define MONITOR_LIVESTATS_H
+
+#include <pthread.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class Processor;
+
+/// Statistics of a running emulator, laid out for readers in other processes
+/// which map the same POSIX shared memory object. Fields are only ever added
+/// at the end, along with a bump of \c VERSION, so a reader can trust every
+/// field up to the \c size it was built for.
+///
+/// Every counter is a lock-free atomic written with relaxed stores by the
+/// CPU thread, so readers see each value whole but not necessarily all of
+/// them from the same update.
+struct LiveStatsBlock {
+  static constexpr uint32_t MAGIC = 0x54534653;  // "SFST"
+  static constexpr uint32_t VERSION = 1;
+
+  /// Threads whose CPU time is reported.
+  enum Thread : uint32_t { CPU, RENDER, RELOAD, NUM_THREADS };
+
+  uint32_t magic;
+  uint32_t version;
+  /// sizeof(LiveStatsBlock) of the writer.
+  uint32_t size;
+  uint32_t pid;
+
+  std::atomic<uint64_t> instructions;
+  std::atomic<uint64_t> cycles;
+  /// Million instructions per second over the last update.
+  std::atomic<double> mips;
+  /// Frames drawn by the renderer, and ROM reloads applied.
+  std::atomic<uint64_t> frames;
+  std::atomic<uint64_t> reloads;
+  /// CPU time of each \c Thread in nanoseconds.
+  std::array<std::atomic<uint64_t>, NUM_THREADS> thread_ns;
+  /// Wall clock (CLOCK_REALTIME) of the last update in nanoseconds.
+  std::atomic<uint64_t> updated_ns;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<double>::is_always_lock_free,
+              "shared atomics must not need a lock");
+
+/// Writer of a \c LiveStatsBlock, for the CPU thread of an emulator.
+class LiveStats {
+ public:
+  /// Guest cycles the CPU thread runs between updates.
+  static constexpr uint64_t BATCH_CYCLES = 1 << 16;
+
+  /// Create the shared memory object \p name, such as "/sfem", replacing any
+  /// left behind by an earlier run.
+  explicit LiveStats(const std::string &name);
+  /// Unmaps and removes the object.
+  ~LiveStats();
+
+  LiveStats(const LiveStats &) = delete;
+  LiveStats &operator=(const LiveStats &) = delete;
+
+  /// False if the object couldn't be created.
+  bool valid() const { return block != nullptr; }
+
+  /// Report the CPU time of \p thread, running on \p handle. The thread
+  /// which publishes is always reported as \c CPU.
+  void track_thread(LiveStatsBlock::Thread thread, pthread_t handle);
+
+  /// Store the counters of \p proc and the time of every thread. Call from
+  /// the CPU thread, between runs.
+  void publish(const Processor &proc);
+
+ private:
+  std::string name;
+  LiveStatsBlock *block = nullptr;
+  std::array<pthread_t, LiveStatsBlock::NUM_THREADS> threads{};
+  std::array<bool, LiveStatsBlock::NUM_THREADS> tracked{};
+
+  /// For the instruction rate.
+  uint64_t last_instructions = 0;
+  std::chrono::steady_clock::time_point last_time;
+};
+
+/// Map the block published under \p name read only. \return nullptr, after
+/// printing why, if there is none or it was written by an incompatible
+/// version.
+const LiveStatsBlock *open_live_stats(const std::string &name);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef RECOMPILER_RECOMPILER_H
+#define RECOMPILER_RECOMPILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Translates a 64 KB ROM into a C++ translation unit which defines the
+/// \c Recompiled runtime (see Recompiler/runtime.h) for that ROM.
+///
+/// Control flow is walked from \c Regions::BOOTLOADER_ADDR and from the NMI,
+/// RESET and IRQ vectors. Every reachable basic block becomes a function which
+/// operates on \c Processor state. Anything that can't be resolved statically,
+/// such as \c JMP_IND targets, the final RTS and code the guest has
+/// overwritten, is handed back to the interpreter at run time. A block checks
+/// its code when it is entered, so it ends after any store which may rewrite
+/// code further on in it.
+class Recompiler {
+ public:
+  explicit Recompiler(const std::vector<uint8_t>& image);
+
+  /// Addresses at which a translated basic block begins.
+  const std::set<word_t>& entries() const { return block_entries; }
+
+  /// Write the translation unit for the image to \p os.
+  void emit(std::ostream& os) const;
+
+ private:
+  const std::vector<uint8_t>& image;
+  std::set<word_t> block_entries;
+
+  void discover();
+  void emit_block(std::ostream& os, word_t start) const;
+  /// \return the C++ statements for the instruction at \p pc. Sets \p ends to
+  /// whether the instruction leaves the block.
+  std::string emit_inst(word_t pc, const InstDesc& desc, bool& ends) const;
+};
+
+#endif
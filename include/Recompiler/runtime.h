@@ -0,0 +1,33 @@
+#ifndef RECOMPILER_RUNTIME_H
+#define RECOMPILER_RUNTIME_H
+
+#include <cstdint>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+
+/// Glue between the interpreter and a ROM translated ahead of time by
+/// sfem-recomp. The generated translation unit defines \c IMAGE, \c lookup and
+/// one specialization of \c block for every basic block it found.
+struct Recompiled {
+  /// A translated basic block. \return true after running the block and
+  /// pointing PC at its successor, or false, without running anything from PC
+  /// on, when the interpreter has to take over.
+  using Block = bool (*)(Processor&);
+
+  /// The ROM the blocks were translated from.
+  static const uint8_t IMAGE[ADDR_SPACE_SZ];
+
+  /// \return the block which starts at \p pc, or nullptr.
+  static Block lookup(word_t pc);
+
+  template <word_t addr>
+  static bool block(Processor& p);
+
+  /// Run \p proc until its top-level routine returns, using translated blocks
+  /// wherever possible and interpreting everything else. \return the final
+  /// value of the accumulator.
+  static uint8_t run(Processor& p);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef RENDER_ATLAS_H
+#define RENDER_ATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Render/framebuffer.h"
+
+/// The displays of several machines packed into one RGBA image, as a grid of
+/// square tiles, so a renderer can keep them in a single texture and draw
+/// them all at once.
+///
+/// Every tile is \c TILE_SIZE pixels square whatever the mode, smaller modes
+/// being scaled up to fill it. A tile is only expanded again when something
+/// its frame depends on changed: the display registers, the palette or the
+/// framebuffer bytes. The pixels of each tile are stored contiguously, row by
+/// row, ready to be uploaded as a sub-rectangle of the texture.
+class TileAtlas {
+ public:
+  static constexpr int TILE_SIZE = FrameExpander::MAX_WIDTH;
+  static_assert(FrameExpander::MAX_WIDTH == FrameExpander::MAX_HEIGHT);
+
+  /// An atlas of \p tiles tiles, in the squarest grid which holds them.
+  explicit TileAtlas(size_t tiles);
+
+  size_t tiles() const { return slots.size(); }
+  int columns() const { return cols; }
+  int rows() const { return (int)((slots.size() + cols - 1) / cols); }
+  /// Size of the whole atlas in pixels.
+  int width() const { return cols * TILE_SIZE; }
+  int height() const { return rows() * TILE_SIZE; }
+
+  /// Redraw tile \p tile from the address space \p mem if its frame changed.
+  /// \return whether it did.
+  bool update(size_t tile, const uint8_t* mem);
+
+  /// \c TILE_SIZE * \c TILE_SIZE RGBA pixels of tile \p tile.
+  const uint32_t* pixels(size_t tile) const {
+    return slots[tile].pixels.data();
+  }
+  /// Pixel position of the top left corner of tile \p tile in the atlas.
+  int x(size_t tile) const { return tile % cols * TILE_SIZE; }
+  int y(size_t tile) const { return tile / cols * TILE_SIZE; }
+
+ private:
+  struct Slot {
+    FrameExpander expander;
+    /// Display registers and framebuffer bytes the pixels were drawn from.
+    std::vector<uint8_t> source;
+    std::vector<uint32_t> pixels;
+  };
+
+  int cols;
+  std::vector<Slot> slots;
+  /// Expanded frame before scaling, shared by all tiles.
+  std::vector<uint32_t> frame;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef RENDER_CAPTURE_H
+#define RENDER_CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "6502/processor.h"
+#include "Render/framebuffer.h"
+
+/// How captured frames are written.
+enum class CaptureFormat {
+  /// One PNG per frame, frame_000000.png onwards, in a directory.
+  PNG,
+  /// Headerless stream of RGBA frames.
+  RAW,
+  /// YUV4MPEG2 stream, 4:4:4 at 60 fps, which ffmpeg and most players read.
+  Y4M,
+};
+
+/// Writes displayed frames to disk without holding up the thread producing
+/// them.
+///
+/// Frames are copied into a fixed ring of slots and written out by an encoder
+/// thread. When the encoder falls behind and every slot is taken, new frames
+/// are dropped and counted rather than waited on. Streams (raw and Y4M) need
+/// a fixed size, so their frames are always \c FrameExpander::MAX_WIDTH by
+/// \c FrameExpander::MAX_HEIGHT, with smaller modes scaled up. PNGs keep the
+/// size of the mode.
+class FrameCapture {
+ public:
+  /// Capture to \p path, whose extension picks the format: .y4m for Y4M, .rgba
+  /// for raw, and anything else is a directory for PNGs. \p slots frames can
+  /// be waiting for the encoder at once.
+  explicit FrameCapture(const std::string& path, size_t slots = 16);
+  /// Write out the queued frames and stop the encoder.
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  /// False if the output couldn't be opened.
+  bool valid() const { return ok; }
+
+  /// Queue a frame of \p mode whose pixels are \p rgba, as filled by
+  /// \c FrameExpander::expand. Never blocks. \return false if it was dropped.
+  bool push(const DisplayModeDesc& mode, const uint32_t* rgba);
+
+  /// Ask loops feeding the capture to finish, e.g. once the guest returned.
+  void close() { closing = true; }
+  bool closed() const { return closing; }
+
+  uint64_t frames_written() const { return written; }
+  uint64_t frames_dropped() const { return dropped; }
+
+ private:
+  struct Frame {
+    word_t width = 0;
+    word_t height = 0;
+    std::vector<uint32_t> rgba;
+  };
+
+  CaptureFormat format;
+  std::string path;
+  std::ofstream stream;
+  bool ok = true;
+
+  /// Ring of frames; [head, head + queued) are waiting for the encoder.
+  std::vector<Frame> ring;
+  size_t head = 0;
+  size_t queued = 0;
+  bool stopping = false;
+  std::mutex lock;
+  std::condition_variable ready;
+
+  std::atomic<bool> closing = false;
+  std::atomic<uint64_t> written = 0;
+  std::atomic<uint64_t> dropped = 0;
+  std::thread encoder;
+
+  void encode_loop();
+  void write(const Frame& frame, uint64_t index);
+};
+
+/// Capture \p proc's display without a window: every 60th of a second expand
+/// the framebuffer into \p capture and raise vsync, as \c draw_loop does.
+/// Stops \p proc after \p frames frames, or runs until \p capture is closed
+/// when \p frames is 0.
+void capture_loop(Processor& proc, FrameCapture& capture, uint64_t frames);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef RENDER_FRAMEBUFFER_H
+#define RENDER_FRAMEBUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Layouts the guest can pick through \c IO::display_mode. The catalogue lives
+/// in displaymodes.def.
+enum class DisplayMode : uint8_t {
+#define DISPLAY_MODE(name, code, width, height, bpp) name = code,
+#include "Render/displaymodes.def"
+};
+
+/// Display mode descriptor.
+struct DisplayModeDesc {
+  DisplayMode mode;
+  word_t width;
+  word_t height;
+  /// Bits per pixel. Pixels are packed left to right from the most
+  /// significant bits of each byte, and rows follow each other without gaps.
+  uint8_t bpp;
+
+  constexpr size_t bytes() const { return (size_t)width * height * bpp / 8; }
+};
+
+/// Turns the guest's framebuffer into RGBA pixels.
+///
+/// Rather than looking up every pixel, each framebuffer byte is expanded with
+/// a 256 entry table holding the RGBA values of all the pixels packed in that
+/// byte. A frame then costs one fixed-size copy of 8 to 32 bytes per
+/// framebuffer byte, which the compiler emits as vector stores, whatever the
+/// mode. The table is only rebuilt when the mode or the palette changes.
+class FrameExpander {
+ public:
+  /// Largest resolution of any mode.
+  static constexpr word_t MAX_WIDTH = 128;
+  static constexpr word_t MAX_HEIGHT = 128;
+
+  /// \return the mode selected by \p code, falling back to \c MONO_64 for
+  /// codes with no mode.
+  static const DisplayModeDesc& describe(uint8_t code);
+  /// Address of the framebuffer selected by \c IO::display_base in \p mem.
+  /// Framebuffers which run off the end of memory wrap to the zero page.
+  static size_t framebuffer_start(const uint8_t* mem);
+
+  /// Expand the framebuffer selected by the display registers in \p mem into
+  /// \p rgba, which holds \c MAX_WIDTH * \c MAX_HEIGHT pixels. Pixels are
+  /// packed R, G, B, A in memory, row by row. \return the mode drawn.
+  const DisplayModeDesc& expand(const uint8_t* mem, uint32_t* rgba);
+
+ private:
+  /// Mode and palette registers the table was built for.
+  int built_mode = -1;
+  std::array<uint8_t, 16> built_palette{};
+  /// RGBA values of the pixels in each possible framebuffer byte.
+  alignas(32) std::array<std::array<uint32_t, 8>, 256> table;
+
+  void rebuild(const DisplayModeDesc& desc, const uint8_t* palette);
+};
+
+#endif
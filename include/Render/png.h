@@ -0,0 +1,21 @@
+#ifndef RENDER_PNG_H
+#define RENDER_PNG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "6502/InstructionSet/instrs.h"
+
+/// Encode \p width by \p height RGBA pixels, packed R, G, B, A in memory, as
+/// a PNG. The pixels go into stored (uncompressed) deflate blocks: images are
+/// tiny, and it keeps the encoder dependency free.
+std::vector<uint8_t> encode_png(const uint32_t* rgba, word_t width,
+                                word_t height);
+
+/// Encode as \c encode_png does and write the result to \p path.
+/// \return false if the file couldn't be written.
+bool write_png(const std::string& path, const uint32_t* rgba, word_t width,
+               word_t height);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef RENDER_WINDOW_H
+#define RENDER_WINDOW_H
+
+#include <vector>
+
+#include "6502/processor.h"
+
+class FrameCapture;
+
+/// Open a window and draw the display region of \p proc until it is closed.
+/// Mouse movement over the window is posted to the IO page, every finished
+/// frame raises vsync, and closing the window stops \p proc. Frames are also
+/// handed to \p capture, if given.
+void draw_loop(Processor& proc, FrameCapture* capture = nullptr);
+
+/// Open a window showing the displays of all of \p procs as a grid, until it
+/// is closed. The displays live in one texture atlas, of which only the tiles
+/// that changed are uploaded, and the whole grid is drawn in a single call.
+/// Every frame raises vsync on every processor, and closing the window stops
+/// them all. There is no mouse input.
+void grid_loop(const std::vector<Processor*>& procs);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef REPLAY_INPUTLOG_H
+#define REPLAY_INPUTLOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "6502/hostevent.h"
+
+class Processor;
+
+/// A host event together with the guest cycle at which it was applied.
+struct LoggedEvent {
+  uint64_t cycle;
+  HostEvent event;
+};
+
+/// Appends every host event a processor applies to a file, after the memory
+/// image the session started from. Replaying the file with \c InputLog
+/// reproduces the session bit for bit.
+///
+/// File layout (little endian):
+///   "SFEMREC" '\0', u32 version, ADDR_SPACE_SZ bytes of initial image,
+///   then per event: u64 cycle, u8 kind, u16 addr, u8 value, and for RELOAD
+///   another ADDR_SPACE_SZ bytes of image. The last event is always STOP.
+class InputRecorder {
+ public:
+  InputRecorder(const std::string& path, const std::vector<uint8_t>& image);
+
+  /// Called by the processor thread as it applies \p event.
+  void append(uint64_t cycle, const HostEvent& event);
+
+ private:
+  std::ofstream out;
+};
+
+/// A recording loaded back into memory.
+class InputLog {
+ public:
+  /// Load \p path. \return false if it isn't a readable recording.
+  bool load(const std::string& path);
+
+  const std::vector<uint8_t>& image() const { return initial_image; }
+  const std::vector<LoggedEvent>& events() const { return logged; }
+
+ private:
+  std::vector<uint8_t> initial_image;
+  std::vector<LoggedEvent> logged;
+};
+
+/// Feed the events of \p log to \p proc at the cycles they were recorded at.
+/// \p proc must have been built on a copy of \c log.image(). Runs until the
+/// recorded STOP. \return false if the guest returned from its top-level
+/// routine before that.
+bool replay(Processor& proc, const InputLog& log);
+
+#endif
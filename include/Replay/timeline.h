@@ -0,0 +1,100 @@
+#ifndef REPLAY_TIMELINE_H
+#define REPLAY_TIMELINE_H
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+
+/// Appends the state of a processor to a file once per frame, for questions
+/// about a session which would otherwise need it replayed, such as where a
+/// variable changed. Only the pages which changed since the previous frame
+/// are stored, so a frame usually costs a few hundred bytes.
+///
+/// File layout (little endian):
+///   "SFEMTLN" '\0', u32 version,
+///   then per frame: u64 cycle, u64 vsync count, u16 PC, u8 AC, X, Y, SR, SP,
+///   u16 page count n, n page numbers as u8, and n pages of PAGE_SZ bytes,
+///   then the index: u64 offset of each frame,
+///   then u64 offset of the index, u64 frame count, "SFEMTIDX".
+/// The first frame stores every page. A file cut short, without its index,
+/// can still be read up to its last whole frame.
+class TimelineRecorder {
+ public:
+  explicit TimelineRecorder(const std::string& path);
+  /// Same as \c close.
+  ~TimelineRecorder();
+
+  bool valid() const { return out.is_open(); }
+
+  /// Store the frame \p proc is at. Called by the processor thread at vsync.
+  void append(const Processor& proc);
+  /// Write the index and close the file.
+  void close();
+
+  uint64_t frames_written() const { return offsets.size(); }
+
+ private:
+  std::ofstream out;
+  /// Memory as of the last frame stored.
+  std::vector<uint8_t> last;
+  std::vector<uint64_t> offsets;
+};
+
+/// A timeline file mapped into memory. Pages are read in place.
+class Timeline {
+ public:
+  Timeline() = default;
+  ~Timeline();
+  Timeline(const Timeline&) = delete;
+  Timeline& operator=(const Timeline&) = delete;
+
+  /// Map \p path. \return false if it isn't a readable timeline.
+  bool load(const std::string& path);
+
+  struct Frame {
+    uint64_t cycle;
+    /// Vsyncs the processor had seen, 0 for a recording started at boot.
+    uint64_t vsync;
+    Processor::Registers regs;
+  };
+  size_t size() const { return frames.size(); }
+  const Frame& frame(size_t i) const { return frames[i]; }
+  /// Whether the file ended with its index, rather than being cut short.
+  bool complete() const { return indexed; }
+
+  /// Value of \p addr at frame \p i.
+  uint8_t byte(word_t addr, size_t i) const;
+  /// First frame after \p from at which \p addr differs from its value at
+  /// \p from, if any.
+  std::optional<size_t> first_change(word_t addr, size_t from = 0) const;
+  /// The frames which stored the page of \p addr, in order. The value of
+  /// \p addr can only change at these.
+  std::vector<size_t> candidates(word_t addr) const;
+
+ private:
+  /// A copy of one page stored by one frame.
+  struct PageVersion {
+    uint32_t frame;
+    const uint8_t* data;
+  };
+
+  /// Parse the frame at \p offset. \return the offset after it, or 0 if it
+  /// doesn't fit in the file.
+  size_t parse_frame(size_t offset);
+  /// First version of \p page stored after frame \p i.
+  std::vector<PageVersion>::const_iterator after(uint8_t page, size_t i) const;
+
+  const uint8_t* map = nullptr;
+  size_t map_size = 0;
+  bool indexed = false;
+  std::vector<Frame> frames;
+  std::array<std::vector<PageVersion>, NUM_PAGES> pages;
+};
+
+#endif
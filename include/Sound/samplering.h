@@ -0,0 +1,46 @@
+#ifndef SOUND_SAMPLERING_H
+#define SOUND_SAMPLERING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Lock-free queue of mono 16 bit samples from one producer thread, the CPU,
+/// to one consumer thread, an audio sink.
+///
+/// Neither side ever waits for the other. When the consumer falls behind and
+/// the ring fills up, new samples are dropped and counted; when the producer
+/// falls behind, the consumer simply gets fewer samples.
+class SampleRing {
+ public:
+  /// A ring holding up to \p capacity samples, rounded up to a power of two.
+  explicit SampleRing(size_t capacity = 1 << 16);
+
+  /// Queue \p n samples from \p samples, as many as fit. Producer only.
+  /// \return how many were queued.
+  size_t push(const int16_t* samples, size_t n);
+  /// Move up to \p n samples into \p out. Consumer only. \return how many.
+  size_t pop(int16_t* out, size_t n);
+
+  /// Samples waiting to be popped.
+  size_t available() const;
+  /// Samples lost to a full ring so far.
+  uint64_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+  /// The producer won't push any more; consumers drain what's left and stop.
+  void close() { done.store(true, std::memory_order_release); }
+  bool closed() const { return done.load(std::memory_order_acquire); }
+
+ private:
+  std::vector<int16_t> samples;
+  size_t mask;
+  /// Total samples ever pushed and popped, on separate cache lines as each is
+  /// written by a different thread.
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+  std::atomic<uint64_t> drops{0};
+  std::atomic<bool> done{false};
+};
+
+#endif
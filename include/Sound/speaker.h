@@ -0,0 +1,34 @@
+#ifndef SOUND_SPEAKER_H
+#define SOUND_SPEAKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+class SampleRing;
+
+/// Audio sink which plays a \c SampleRing through raylib's audio device, on a
+/// thread of its own. When the guest can't keep up, the last sample is held
+/// to fill the gap, rather than clicking back to silence.
+class Speaker {
+ public:
+  Speaker(SampleRing& ring, uint32_t rate);
+  /// Stops playback and closes the device.
+  ~Speaker();
+
+  Speaker(const Speaker&) = delete;
+  Speaker& operator=(const Speaker&) = delete;
+
+  /// Whether there is an audio device on this host.
+  static bool available();
+
+ private:
+  SampleRing& ring;
+  uint32_t rate;
+  std::atomic<bool> stopping = false;
+  std::thread player;
+
+  void play();
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SOUND_WAVWRITER_H
+#define SOUND_WAVWRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+class SampleRing;
+
+/// Audio sink for headless runs: a thread which drains a \c SampleRing into
+/// a 16 bit mono WAV file as samples arrive.
+class WavWriter {
+ public:
+  /// Start writing the samples of \p ring, at \p rate per second, to \p path.
+  WavWriter(const std::string& path, SampleRing& ring, uint32_t rate);
+  /// Same as \c finish.
+  ~WavWriter();
+
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator=(const WavWriter&) = delete;
+
+  /// False if the file couldn't be created.
+  bool valid() const { return out.is_open(); }
+
+  /// Close the ring, write what's left in it, and complete the file.
+  void finish();
+
+  uint64_t samples_written() const { return written; }
+
+ private:
+  SampleRing& ring;
+  std::ofstream out;
+  uint32_t rate;
+  uint64_t written = 0;
+  std::thread drainer;
+
+  void drain();
+  /// Write the RIFF header for the samples written so far.
+  void write_header();
+};
+
+#endif
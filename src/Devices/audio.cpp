@@ -0,0 +1,92 @@
+#include "Devices/audio.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "Sound/samplering.h"
+
+namespace {
+/// Amplitude of one step of channel volume, and of one step of the DAC.
+constexpr int VOLUME_STEP = 512;
+constexpr int DAC_STEP = 64;
+/// Period of the noise shift register, after which it repeats.
+constexpr uint32_t LFSR_PERIOD = 32767;
+
+word_t offset(word_t reg) { return reg - IO::audio_square0_period; }
+}  // namespace
+
+word_t AudioUnit::reg_word(word_t addr) const {
+  return regs[offset(addr)] | regs[offset(addr) + 1] << 8;
+}
+
+void AudioUnit::reset(uint64_t now) {
+  regs.fill(0);
+  squares = {};
+  noise_phase = 0;
+  lfsr = 1;
+  clock = now;
+  origin = now;
+  emitted = 0;
+}
+
+void AudioUnit::latch(const uint8_t* mem) {
+  std::copy(mem + IO::audio_square0_period,
+            mem + IO::audio_square0_period + NUM_REGS, regs.begin());
+}
+
+void AudioUnit::advance(uint64_t cycles) {
+  static constexpr word_t PERIODS[] = {IO::audio_square0_period,
+                                       IO::audio_square1_period};
+  for (size_t i = 0; i < squares.size(); i++) {
+    uint32_t period = reg_word(PERIODS[i]);
+    if (!period) continue;
+    squares[i].phase = (squares[i].phase + cycles) % (2 * period);
+  }
+  uint32_t period = reg_word(IO::audio_noise_period);
+  if (!period) return;
+  uint64_t steps = (noise_phase + cycles) / period;
+  noise_phase = (noise_phase + cycles) % period;
+  for (steps %= LFSR_PERIOD; steps; steps--) {
+    uint16_t bit = (lfsr ^ lfsr >> 1) & 1;
+    lfsr = lfsr >> 1 | bit << 14;
+  }
+}
+
+int16_t AudioUnit::mix() const {
+  int sample = 0;
+  static constexpr word_t SQUARES[][2] = {
+      {IO::audio_square0_period, IO::audio_square0_volume},
+      {IO::audio_square1_period, IO::audio_square1_volume}};
+  for (size_t i = 0; i < squares.size(); i++) {
+    uint32_t period = reg_word(SQUARES[i][0]);
+    int volume = (regs[offset(SQUARES[i][1])] & 0xF) * VOLUME_STEP;
+    if (period) sample += squares[i].phase < period ? volume : -volume;
+  }
+  if (reg_word(IO::audio_noise_period)) {
+    int volume = (regs[offset(IO::audio_noise_volume)] & 0xF) * VOLUME_STEP;
+    sample += lfsr & 1 ? volume : -volume;
+  }
+  sample += (int8_t)regs[offset(IO::audio_dac)] * DAC_STEP;
+  return std::clamp(sample, INT16_MIN, INT16_MAX);
+}
+
+void AudioUnit::render(uint64_t now, SampleRing& ring) {
+  int16_t batch[256];
+  size_t n = 0;
+  for (;;) {
+    // Sample times are worked out from the start, so they never drift.
+    uint64_t at = origin + (emitted + 1) * CLOCK_HZ / SAMPLE_RATE;
+    if (at > now) break;
+    advance(at - clock);
+    clock = at;
+    batch[n++] = mix();
+    ++emitted;
+    if (n == std::size(batch)) {
+      ring.push(batch, n);
+      n = 0;
+    }
+  }
+  if (n) ring.push(batch, n);
+  advance(now - clock);
+  clock = now;
+}
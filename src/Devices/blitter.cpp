@@ -0,0 +1,107 @@
+#include "Devices/blitter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "6502/InstructionSet/address_space.h"
+
+namespace {
+word_t read_word(const uint8_t* mem, word_t addr) {
+  return mem[addr] | mem[(word_t)(addr + 1)] << 8;
+}
+
+/// A count register, where 0 stands for 256.
+unsigned read_count(const uint8_t* mem, word_t addr) {
+  return mem[addr] ? mem[addr] : 256;
+}
+
+/// Apply \p op to one row of \p width bytes.
+void blit_row(uint8_t* mem, BlitOp op, word_t src, word_t dst, unsigned width,
+              uint8_t fill) {
+  // Rows which run off the end of memory wrap byte by byte. A copy reads its
+  // whole source row first, so that overlapping rows come out as with
+  // memmove below.
+  if (dst + width > ADDR_SPACE_SZ || src + width > ADDR_SPACE_SZ) {
+    uint8_t row[256];
+    if (op == BlitOp::COPY) {
+      for (unsigned i = 0; i < width; i++) row[i] = mem[(word_t)(src + i)];
+    }
+    for (unsigned i = 0; i < width; i++) {
+      word_t d = dst + i;
+      word_t s = src + i;
+      switch (op) {
+        case BlitOp::FILL:
+          mem[d] = fill;
+          break;
+        case BlitOp::COPY:
+          mem[d] = row[i];
+          break;
+        case BlitOp::OR:
+          mem[d] |= mem[s];
+          break;
+        case BlitOp::NONE:
+          break;
+      }
+    }
+    return;
+  }
+  switch (op) {
+    case BlitOp::FILL:
+      memset(mem + dst, fill, width);
+      break;
+    case BlitOp::COPY:
+      memmove(mem + dst, mem + src, width);
+      break;
+    case BlitOp::OR:
+      for (unsigned i = 0; i < width; i++) mem[dst + i] |= mem[src + i];
+      break;
+    case BlitOp::NONE:
+      break;
+  }
+}
+}  // namespace
+
+word_t Blitter::destination(const uint8_t* mem) {
+  return read_word(mem, IO::blit_dst);
+}
+
+uint32_t Blitter::extent(const uint8_t* mem) {
+  unsigned width = read_count(mem, IO::blit_width);
+  unsigned height = read_count(mem, IO::blit_height);
+  return (height - 1) * mem[IO::blit_dst_stride] + width;
+}
+
+uint64_t Blitter::run(uint8_t* mem, uint8_t cmd) {
+  BlitOp op = static_cast<BlitOp>(cmd);
+  uint64_t per_byte;
+  switch (op) {
+    case BlitOp::FILL:
+      per_byte = FILL_CYCLES;
+      break;
+    case BlitOp::COPY:
+    case BlitOp::OR:
+      per_byte = COPY_CYCLES;
+      break;
+    default:
+      return 0;
+  }
+
+  word_t src = read_word(mem, IO::blit_src);
+  word_t dst = read_word(mem, IO::blit_dst);
+  unsigned width = read_count(mem, IO::blit_width);
+  unsigned height = read_count(mem, IO::blit_height);
+  uint8_t src_stride = mem[IO::blit_src_stride];
+  uint8_t dst_stride = mem[IO::blit_dst_stride];
+  uint8_t fill = mem[IO::blit_fill];
+
+  for (unsigned row = 0; row < height; row++) {
+    blit_row(mem, op, src + row * src_stride, dst + row * dst_stride, width,
+             fill);
+  }
+
+  uint64_t cost = SETUP_CYCLES + per_byte * width * height;
+  uint16_t reported = std::min<uint64_t>(cost, UINT16_MAX);
+  mem[IO::blit_cost] = reported & 0xFF;
+  mem[IO::blit_cost + 1] = reported >> 8;
+  return cost;
+}
@@ -0,0 +1,88 @@
+#include "Devices/console.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+#include "6502/InstructionSet/address_space.h"
+
+Console::~Console() {
+  hand_off();
+  if (!writer.joinable()) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+}
+
+bool Console::write(word_t addr, uint8_t value) {
+  if (fd < 0) return false;
+  static constexpr char DIGITS[] = "0123456789abcdef";
+  bool started = buffer.empty();
+  switch (addr) {
+    case IO::console_char:
+      buffer += (char)value;
+      break;
+    case IO::console_hex:
+      buffer += DIGITS[value >> 4];
+      buffer += DIGITS[value & 0xF];
+      break;
+    case IO::console_dec:
+    case IO::console_signed: {
+      char digits[4];
+      int number = addr == IO::console_dec ? value : (int8_t)value;
+      auto [end, ec] = std::to_chars(digits, std::end(digits), number);
+      buffer.append(digits, end);
+      break;
+    }
+    case IO::console_bin:
+      for (int bit = 7; bit >= 0; bit--) buffer += '0' + (value >> bit & 1);
+      break;
+    case IO::console_flush:
+      hand_off();
+      return false;
+    default:
+      return false;
+  }
+  if (buffer.size() >= HANDOFF_BYTES) {
+    hand_off();
+    return false;
+  }
+  return started;
+}
+
+void Console::hand_off() {
+  if (buffer.empty()) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queued += buffer;
+  }
+  buffer.clear();
+  if (!writer.joinable()) writer = std::thread(&Console::write_loop, this);
+  wake.notify_one();
+}
+
+void Console::write_loop() {
+  std::string text;
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wake.wait(guard, [this] { return stopping || !queued.empty(); });
+    if (queued.empty()) return;
+    text.swap(queued);
+    guard.unlock();
+    for (size_t done = 0; done < text.size();) {
+      ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) {
+        std::cerr << "write failed: " << strerror(errno) << std::endl;
+        break;
+      }
+      done += n;
+    }
+    text.clear();
+    guard.lock();
+  }
+}
@@ -0,0 +1,95 @@
+#include "Devices/mathunit.h"
+
+#include "6502/InstructionSet/address_space.h"
+
+namespace {
+word_t read_word(const uint8_t* mem, word_t addr) {
+  return mem[addr] | mem[addr + 1] << 8;
+}
+
+void write_word(uint8_t* mem, word_t addr, word_t value) {
+  mem[addr] = value & 0xFF;
+  mem[addr + 1] = value >> 8;
+}
+
+bool fits_int16(int32_t v) { return v >= INT16_MIN && v <= INT16_MAX; }
+}  // namespace
+
+uint64_t MathUnit::run(uint8_t* mem, uint8_t code) {
+  MathOp op = static_cast<MathOp>(code);
+  uint64_t cost = latency(op);
+  if (!cost) return 0;
+
+  word_t a = read_word(mem, IO::math_a);
+  word_t b = read_word(mem, IO::math_b);
+  int16_t sa = a;
+  int16_t sb = b;
+  uint32_t result = 0;
+  word_t remainder = 0;
+  uint8_t status = 0;
+
+  switch (op) {
+    case MathOp::MUL8:
+      result = (a & 0xFF) * (b & 0xFF);
+      break;
+    case MathOp::MUL16:
+      result = (uint32_t)a * b;
+      break;
+    case MathOp::DIV16:
+      if (!(b & 0xFF)) {
+        status |= MATH_DIV_ZERO;
+        result = 0xFFFF;
+        remainder = a;
+        break;
+      }
+      result = a / (b & 0xFF);
+      remainder = a % (b & 0xFF);
+      break;
+    case MathOp::SMUL8:
+      result = (int8_t)a * (int8_t)b;
+      break;
+    case MathOp::SMUL16:
+      result = (int32_t)sa * sb;
+      break;
+    case MathOp::SDIV16: {
+      int8_t divisor = b;
+      if (!divisor) {
+        status |= MATH_DIV_ZERO;
+        result = 0xFFFF;
+        remainder = a;
+        break;
+      }
+      int32_t quotient = sa / divisor;
+      if (!fits_int16(quotient)) status |= MATH_OVERFLOW;
+      result = quotient;
+      remainder = sa % divisor;
+      break;
+    }
+    case MathOp::FMUL: {
+      int32_t product = ((int32_t)sa * sb) >> 8;
+      if (!fits_int16(product)) status |= MATH_OVERFLOW;
+      result = product;
+      break;
+    }
+    case MathOp::FDIV: {
+      if (!sb) {
+        status |= MATH_DIV_ZERO;
+        result = 0xFFFF;
+        remainder = a;
+        break;
+      }
+      int32_t quotient = (int32_t)sa * 256 / sb;
+      if (!fits_int16(quotient)) status |= MATH_OVERFLOW;
+      result = quotient;
+      break;
+    }
+    case MathOp::NONE:
+      break;
+  }
+
+  write_word(mem, IO::math_result, result & 0xFFFF);
+  write_word(mem, IO::math_result + 2, result >> 16);
+  write_word(mem, IO::math_remainder, remainder);
+  mem[IO::math_status] = status;
+  return cost;
+}
@@ -0,0 +1,66 @@
+#include "Devices/scheduler.h"
+
+#include <algorithm>
+
+namespace {
+/// Heap order for a min-heap with the standard heap algorithms.
+struct Later {
+  template <typename Entry>
+  bool operator()(const Entry& a, const Entry& b) const {
+    return a.cycle > b.cycle;
+  }
+};
+}  // namespace
+
+void DeviceScheduler::schedule(DeviceEvent event, uint64_t cycle) {
+  size_t i = (size_t)event;
+  deadlines[i] = cycle;
+  heap.push_back({cycle, ++generations[i], event});
+  std::push_heap(heap.begin(), heap.end(), Later{});
+  // A device rescheduling over and over before its deadline leaves one stale
+  // entry each time. Start over from the live ones once they pile up.
+  if (heap.size() > 4 * NUM_EVENTS + 16) {
+    heap.clear();
+    for (size_t e = 0; e < NUM_EVENTS; e++) {
+      if (deadlines[e] != UINT64_MAX) {
+        heap.push_back({deadlines[e], generations[e], (DeviceEvent)e});
+      }
+    }
+    std::make_heap(heap.begin(), heap.end(), Later{});
+  }
+  settle();
+}
+
+void DeviceScheduler::cancel(DeviceEvent event) {
+  size_t i = (size_t)event;
+  deadlines[i] = UINT64_MAX;
+  ++generations[i];
+  settle();
+}
+
+void DeviceScheduler::clear() {
+  heap.clear();
+  deadlines.fill(UINT64_MAX);
+  for (uint32_t& generation : generations) ++generation;
+  next_deadline = UINT64_MAX;
+}
+
+bool DeviceScheduler::pop_due(uint64_t now, DeviceEvent& event,
+                              uint64_t& due) {
+  if (next_deadline > now) return false;
+  const Entry& top = heap.front();
+  event = top.event;
+  due = top.cycle;
+  cancel(event);
+  return true;
+}
+
+void DeviceScheduler::settle() {
+  while (!heap.empty()) {
+    const Entry& top = heap.front();
+    if (top.generation == generations[(size_t)top.event]) break;
+    std::pop_heap(heap.begin(), heap.end(), Later{});
+    heap.pop_back();
+  }
+  next_deadline = heap.empty() ? UINT64_MAX : heap.front().cycle;
+}
@@ -1,46 +1,199 @@
 #include "HotReload/filewatcher.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 
-FileWatcher::FileWatcher(const char *fpath, std::function<void()> onChange) {
-  int fd, wd;
-  char buffer[sizeof(inotify_event)];
+namespace {
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO;
 
-  // Initialize inotify
-  fd = inotify_init();
-  if (fd < 0) {
+bool ends_with(const std::string& s, const char* suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+/// Files editors create next to the one being edited: vim swap files and its
+/// "4913" write test, emacs lock and autosave files, and backups.
+bool is_temp_file(const std::string& name) {
+  if (name.empty()) return false;
+  return name[0] == '.' || name[0] == '#' || name.back() == '~' ||
+         name == "4913" || ends_with(name, ".swp") ||
+         ends_with(name, ".swx") || ends_with(name, ".tmp");
+}
+}  // namespace
+
+FileWatcher::FileWatcher(std::chrono::milliseconds debounce)
+    : debounce(debounce) {
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) {
     std::cerr << "inotify_init failed: " << strerror(errno) << std::endl;
     return;
   }
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (stop_fd < 0) {
+    std::cerr << "eventfd failed: " << strerror(errno) << std::endl;
+    return;
+  }
+  int fd = epoll_create1(EPOLL_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "epoll_create failed: " << strerror(errno) << std::endl;
+    return;
+  }
+  for (int source : {inotify_fd, stop_fd}) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = source;
+    if (epoll_ctl(fd, EPOLL_CTL_ADD, source, &event) < 0) {
+      std::cerr << "epoll_ctl failed: " << strerror(errno) << std::endl;
+      close(fd);
+      return;
+    }
+  }
+  epoll_fd = fd;
+}
 
-  // wd = inotify_add_watch(fd, fpath, IN_MODIFY | IN_MOVED_FROM);
-  wd = inotify_add_watch(fd, fpath, IN_CLOSE_WRITE);
+FileWatcher::~FileWatcher() {
+  for (int fd : {epoll_fd, stop_fd, inotify_fd}) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+int FileWatcher::watch(const std::string& path,
+                       std::function<void()> on_change) {
+  if (!valid()) return -1;
+  std::filesystem::path dir = path;
+  std::string name;
+  struct stat info;
+  if (stat(path.c_str(), &info) < 0 || !S_ISDIR(info.st_mode)) {
+    name = dir.filename();
+    dir = dir.parent_path();
+    if (dir.empty()) dir = ".";
+  }
+  // Watching a directory twice returns the same watch.
+  int wd = inotify_add_watch(inotify_fd, dir.c_str(), WATCH_MASK);
   if (wd < 0) {
     std::cerr << "inotify_add_watch failed: " << strerror(errno) << std::endl;
-    close(fd);
-    return;
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  int id = next_id++;
+  subscriptions[id] = {wd, name, std::move(on_change)};
+  by_watch[wd].push_back(id);
+  return id;
+}
+
+void FileWatcher::unwatch(int id) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto sub = subscriptions.find(id);
+  if (sub == subscriptions.end()) return;
+  int wd = sub->second.wd;
+  subscriptions.erase(sub);
+  pending.erase(id);
+  std::vector<int>& ids = by_watch[wd];
+  ids.erase(std::find(ids.begin(), ids.end(), id));
+  if (ids.empty()) {
+    by_watch.erase(wd);
+    inotify_rm_watch(inotify_fd, wd);
   }
+}
 
+void FileWatcher::run() {
+  if (!valid()) return;
+  int timeout = -1;
   while (true) {
-    int len = read(fd, buffer, sizeof(buffer));
-    if (len < 0) {
-      std::cerr << "read failed: " << strerror(errno) << std::endl;
-      close(fd);
+    epoll_event ready[2];
+    int n = epoll_wait(epoll_fd, ready, 2, timeout);
+    if (n < 0 && errno != EINTR) {
+      std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      if (ready[i].data.fd == stop_fd) {
+        // Waking up is all that matters; the count is not.
+        uint64_t count;
+        ssize_t got = read(stop_fd, &count, sizeof(count));
+        (void)got;
+        return;
+      }
+      drain();
+    }
+    timeout = fire_due();
+  }
+}
+
+void FileWatcher::stop() {
+  // An eventfd write only fails once the counter would overflow, and then
+  // run() has a wakeup pending anyway.
+  uint64_t one = 1;
+  ssize_t written = write(stop_fd, &one, sizeof(one));
+  (void)written;
+}
+
+void FileWatcher::drain() {
+  // Events carry their file name, so they vary in size; read many at once.
+  constexpr size_t MAX_EVENT = sizeof(inotify_event) + NAME_MAX + 1;
+  alignas(inotify_event) char buffer[16 * MAX_EVENT];
+  while (true) {
+    ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+    if (len <= 0) {
+      if (len < 0 && errno != EAGAIN && errno != EINTR) {
+        std::cerr << "read failed: " << strerror(errno) << std::endl;
+      }
       return;
     }
 
-    // Process events
-    for (char *ptr = buffer; ptr < buffer + len;
-         ptr += sizeof(struct inotify_event)) {
-      const struct inotify_event *event = (const struct inotify_event *)ptr;
-      if (event->mask & IN_CLOSE_WRITE) {
-        onChange();
+    Clock::time_point due = Clock::now() + debounce;
+    std::lock_guard<std::mutex> guard(lock);
+    for (char* ptr = buffer; ptr < buffer + len;) {
+      const inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+      ptr += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, so anything may have changed.
+        for (const auto& [id, sub] : subscriptions) pending[id] = due;
+        continue;
+      }
+      std::string name = event->len ? event->name : "";
+      if (is_temp_file(name)) continue;
+      auto ids = by_watch.find(event->wd);
+      if (ids == by_watch.end()) continue;
+      for (int id : ids->second) {
+        const std::string& wanted = subscriptions[id].name;
+        if (wanted.empty() || wanted == name) pending[id] = due;
+      }
+    }
+  }
+}
+
+int FileWatcher::fire_due() {
+  std::vector<std::function<void()>> callbacks;
+  int timeout = -1;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    Clock::time_point now = Clock::now();
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (it->second <= now) {
+        callbacks.push_back(subscriptions[it->first].on_change);
+        it = pending.erase(it);
+        continue;
       }
+      auto wait =
+          std::chrono::ceil<std::chrono::milliseconds>(it->second - now);
+      if (timeout < 0 || wait.count() < timeout) timeout = wait.count();
+      ++it;
     }
   }
+  // Callbacks may watch, unwatch or stop, so run them without the lock.
+  for (const auto& callback : callbacks) callback();
+  return timeout;
 }
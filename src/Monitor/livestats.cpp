@@ -0,0 +1,123 @@
+#include "Monitor/livestats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <new>
+
+#include "6502/processor.h"
+
+namespace {
+/// Nanoseconds on \p clock, or 0 if it can't be read, as for a thread that
+/// has exited.
+uint64_t clock_ns(clockid_t clock) {
+  timespec ts;
+  if (clock_gettime(clock, &ts) < 0) return 0;
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+}  // namespace
+
+LiveStats::LiveStats(const std::string &name)
+    : name(name), last_time(std::chrono::steady_clock::now()) {
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
+    return;
+  }
+  if (ftruncate(fd, sizeof(LiveStatsBlock)) < 0) {
+    std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    return;
+  }
+  void *mem = mmap(nullptr, sizeof(LiveStatsBlock), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+    shm_unlink(name.c_str());
+    return;
+  }
+  // The object starts zeroed, which is a valid state for every field.
+  block = new (mem) LiveStatsBlock{};
+  block->version = LiveStatsBlock::VERSION;
+  block->size = sizeof(LiveStatsBlock);
+  block->pid = getpid();
+  std::atomic_thread_fence(std::memory_order_release);
+  block->magic = LiveStatsBlock::MAGIC;
+}
+
+LiveStats::~LiveStats() {
+  if (!block) return;
+  munmap(block, sizeof(LiveStatsBlock));
+  shm_unlink(name.c_str());
+}
+
+void LiveStats::track_thread(LiveStatsBlock::Thread thread,
+                             pthread_t handle) {
+  threads[thread] = handle;
+  tracked[thread] = true;
+}
+
+void LiveStats::publish(const Processor &proc) {
+  if (!block) return;
+  constexpr auto relaxed = std::memory_order_relaxed;
+  uint64_t instructions = proc.instruction_count();
+  block->instructions.store(instructions, relaxed);
+  block->cycles.store(proc.cycle_count(), relaxed);
+  block->frames.store(proc.vsync_count(), relaxed);
+  block->reloads.store(proc.reload_count(), relaxed);
+
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::micro> elapsed = now - last_time;
+  // Batches can be much shorter than the clock's resolution is useful for.
+  if (elapsed.count() >= 100000) {
+    block->mips.store((instructions - last_instructions) / elapsed.count(),
+                      relaxed);
+    last_instructions = instructions;
+    last_time = now;
+  }
+
+  block->thread_ns[LiveStatsBlock::CPU].store(
+      clock_ns(CLOCK_THREAD_CPUTIME_ID), relaxed);
+  for (size_t thread = 0; thread < threads.size(); thread++) {
+    clockid_t clock;
+    if (thread == LiveStatsBlock::CPU || !tracked[thread] ||
+        pthread_getcpuclockid(threads[thread], &clock) != 0) {
+      continue;
+    }
+    uint64_t ns = clock_ns(clock);
+    if (ns) block->thread_ns[thread].store(ns, relaxed);
+  }
+  block->updated_ns.store(clock_ns(CLOCK_REALTIME), relaxed);
+}
+
+const LiveStatsBlock *open_live_stats(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  void *mem =
+      mmap(nullptr, sizeof(LiveStatsBlock), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+    return nullptr;
+  }
+  auto *block = static_cast<const LiveStatsBlock *>(mem);
+  if (block->magic != LiveStatsBlock::MAGIC ||
+      block->size < sizeof(LiveStatsBlock)) {
+    std::cerr << name << ": not a stats block of version "
+              << LiveStatsBlock::VERSION << " or later" << std::endl;
+    munmap(mem, sizeof(LiveStatsBlock));
+    return nullptr;
+  }
+  return block;
+}
@@ -0,0 +1,491 @@
+#include "Recompiler/recompiler.h"
+
+#include <cstdio>
+#include <sstream>
+
+#include "6502/InstructionSet/address_space.h"
+
+namespace {
+/// Interrupt vectors: NMI, RESET and IRQ/BRK.
+constexpr word_t VECTORS[] = {0xFFFA, 0xFFFC, 0xFFFE};
+
+std::string hex(unsigned value, int digits) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "0x%0*X", digits, value);
+  return buf;
+}
+
+bool is_branch(Mnemonic mon) {
+  switch (mon) {
+    case Mnemonic::BCC:
+    case Mnemonic::BCS:
+    case Mnemonic::BEQ:
+    case Mnemonic::BMI:
+    case Mnemonic::BNE:
+    case Mnemonic::BPL:
+    case Mnemonic::BVC:
+    case Mnemonic::BVS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Instructions which are always left to the interpreter.
+bool is_interpreted(Mnemonic mon) {
+  switch (mon) {
+    case Mnemonic::INVALID:
+    case Mnemonic::BRK:
+    case Mnemonic::PLP:
+    case Mnemonic::RTI:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Whether \p desc, with operand \p operand, may write to an address in
+/// [\p begin, \p end).
+bool may_write(const InstDesc& desc, word_t operand, uint32_t begin,
+               uint32_t end) {
+  switch (desc.mon) {
+    case Mnemonic::STA:
+    case Mnemonic::STX:
+    case Mnemonic::STY:
+    case Mnemonic::INC:
+    case Mnemonic::DEC:
+    case Mnemonic::ASL:
+    case Mnemonic::LSR:
+    case Mnemonic::ROL:
+    case Mnemonic::ROR:
+      break;
+    default:
+      return false;
+  }
+  // The highest address written, which indexing may take past $FFFF for the
+  // absolute modes; the interpreter wraps those around.
+  uint32_t last = operand;
+  switch (desc.mode) {
+    case AdrMode::A:
+      return false;
+    case AdrMode::ZPG:
+    case AdrMode::ABS:
+      break;
+    case AdrMode::ZP_X:
+    case AdrMode::ZP_Y:
+    case AdrMode::ABS_X:
+    case AdrMode::ABS_Y:
+      last += 0xFF;
+      break;
+    default:
+      return true;
+  }
+  auto overlaps = [=](uint32_t lo, uint32_t hi) {
+    return lo < end && hi >= begin;
+  };
+  return overlaps(operand, last) ||
+         (last >= ADDR_SPACE_SZ && overlaps(0, last - ADDR_SPACE_SZ));
+}
+
+/// Whether \p desc, with operand \p operand, may write to the IO page. Such
+/// a write can start a wait or unmask an interrupt, which are only noticed
+/// between blocks, so it has to end its block.
+bool may_write_io(const InstDesc& desc, word_t operand) {
+  return may_write(desc, operand, Regions::IO.begin,
+                   Regions::IO.begin + Regions::IO.num_pages * PAGE_SZ);
+}
+
+/// End of the straight-line code in \p image from \p pc: just past the first
+/// branch, jump, call or return, or at the first instruction left to the
+/// interpreter. No block starting at \p pc reaches further.
+uint32_t straight_end(const std::vector<uint8_t>& image, uint32_t pc) {
+  while (pc < ADDR_SPACE_SZ) {
+    InstDesc desc = decode_desc(image[pc]);
+    if (is_interpreted(desc.mon) || pc + desc.sz > ADDR_SPACE_SZ) break;
+    pc += desc.sz;
+    if (is_branch(desc.mon) || desc.mon == Mnemonic::JMP ||
+        desc.mon == Mnemonic::JSR || desc.mon == Mnemonic::RTS) {
+      break;
+    }
+  }
+  return pc;
+}
+
+std::string update_nz(const std::string& value) {
+  return "p.SR.N = " + value + " & 0x80; p.SR.Z = " + value + " == 0; ";
+}
+}  // namespace
+
+Recompiler::Recompiler(const std::vector<uint8_t>& image) : image(image) {
+  discover();
+}
+
+void Recompiler::discover() {
+  std::vector<word_t> work = {Regions::BOOTLOADER_ADDR};
+  for (word_t vector : VECTORS) {
+    word_t target = image[vector] | image[vector + 1] << 8;
+    // Unset vectors point into the zero page.
+    if (target >= Regions::BOOTLOADER_ADDR) work.push_back(target);
+  }
+
+  while (!work.empty()) {
+    word_t start = work.back();
+    work.pop_back();
+    if (!block_entries.insert(start).second) continue;
+
+    uint32_t pc = start;
+    while (true) {
+      InstDesc desc = decode_desc(image[pc]);
+      if (is_interpreted(desc.mon) || pc + desc.sz > ADDR_SPACE_SZ) break;
+      word_t operand = 0;
+      if (desc.sz == 2) operand = image[pc + 1];
+      if (desc.sz == 3) operand = image[pc + 1] | image[pc + 2] << 8;
+      if (is_branch(desc.mon)) {
+        work.push_back(pc + 2 + (int8_t)image[pc + 1]);
+        work.push_back(pc + 2);
+        break;
+      }
+      if (desc.mon == Mnemonic::JMP) {
+        if (desc.mode == AdrMode::ABS) work.push_back(operand);
+        break;
+      }
+      if (desc.mon == Mnemonic::JSR) {
+        work.push_back(operand);
+        work.push_back(pc + 3);
+        break;
+      }
+      if (desc.mon == Mnemonic::RTS) break;
+      // A block only checks its code on entry, so a store which may rewrite
+      // the code after it ends the block, and the next one checks again.
+      uint32_t next = pc + desc.sz;
+      if (may_write_io(desc, operand) ||
+          may_write(desc, operand, next, straight_end(image, next))) {
+        if (next < ADDR_SPACE_SZ) work.push_back(next);
+        break;
+      }
+      pc += desc.sz;
+    }
+  }
+}
+
+void Recompiler::emit(std::ostream& os) const {
+  os << "// Generated by sfem-recomp. Do not edit.\n\n"
+        "#include <cstring>\n\n"
+        "#include \"Recompiler/runtime.h\"\n\n";
+
+  os << "const uint8_t Recompiled::IMAGE[ADDR_SPACE_SZ] = {";
+  for (size_t i = 0; i < image.size(); i++) {
+    os << (i % 16 ? " " : "\n    ") << hex(image[i], 2) << ",";
+  }
+  os << "\n};\n\n";
+
+  for (word_t start : block_entries) emit_block(os, start);
+
+  os << "Recompiled::Block Recompiled::lookup(word_t pc) {\n"
+        "  switch (pc) {\n";
+  for (word_t start : block_entries) {
+    os << "    case " << hex(start, 4) << ":\n"
+       << "      return &Recompiled::block<" << hex(start, 4) << ">;\n";
+  }
+  os << "    default:\n"
+        "      return nullptr;\n"
+        "  }\n"
+        "}\n";
+}
+
+void Recompiler::emit_block(std::ostream& os, word_t start) const {
+  std::ostringstream body;
+  uint32_t pc = start;
+  bool ends = false;
+  uint32_t translated = 0;
+  while (!ends) {
+    // Fall through into the next block rather than translating it twice.
+    if (pc != start && block_entries.count(pc)) {
+      body << "  p.PC = " << hex(pc, 4) << ";\n  return true;\n";
+      break;
+    }
+    InstDesc desc = decode_desc(image[pc]);
+    if (is_interpreted(desc.mon) || pc + desc.sz > ADDR_SPACE_SZ) {
+      body << "  p.PC = " << hex(pc, 4) << ";\n  return false;\n";
+      break;
+    }
+    body << "  // " << hex(pc, 4) << ": " << desc << "\n";
+    std::string code = emit_inst(pc, desc, ends);
+    while (code.back() == ' ') code.pop_back();
+    body << "  {\n    " << code << "\n  }\n";
+    pc += desc.sz;
+    ++translated;
+  }
+
+  std::string addr = hex(start, 4);
+  os << "template <>\n"
+     << "bool Recompiled::block<" << addr << ">(Processor& p) {\n"
+     << "  // The guest overwrote this block since it was translated.\n"
+     << "  if (memcmp(&p.RAM[" << addr << "], &IMAGE[" << addr << "], "
+     << pc - start << ") != 0) {\n"
+     << "    return false;\n"
+     << "  }\n";
+  // A block only returns at its last instruction, so it retires them all up
+  // front rather than one by one as the interpreter does.
+  if (translated) os << "  p.retired += " << translated << ";\n";
+  os << body.str() << "}\n\n";
+}
+
+std::string Recompiler::emit_inst(word_t pc, const InstDesc& desc,
+                                  bool& ends) const {
+  // The statements mirror the interpreter in processor.cpp so that a block
+  // and the fallback leave exactly the same state behind.
+  std::ostringstream out;
+  uint8_t lo = image[(word_t)(pc + 1)];
+  word_t abs = lo | image[(word_t)(pc + 2)] << 8;
+  if (desc.mon == Mnemonic::RTS) {
+    // The final RTS stops the machine, which only the interpreter can do.
+    // It retires the RTS then, rather than the block.
+    out << "if (p.SP == p.return_SP) { --p.retired; p.PC = " << hex(pc, 4)
+        << "; return false; } ";
+  }
+  out << "p.cycles += " << (int)desc.cycles << "; ";
+
+  // Effective address and operand. Jumps use the absolute address directly.
+  std::string ea;
+  bool is_jump = desc.mon == Mnemonic::JMP || desc.mon == Mnemonic::JSR;
+  switch (is_jump ? AdrMode::IMP : desc.mode) {
+    case AdrMode::ZPG:
+      ea = hex(lo, 2);
+      break;
+    case AdrMode::ZP_X:
+      ea = "(word_t)(" + hex(lo, 2) + " + p.X)";
+      break;
+    case AdrMode::ZP_Y:
+      ea = "(word_t)(" + hex(lo, 2) + " + p.Y)";
+      break;
+    case AdrMode::ABS:
+      ea = hex(abs, 4);
+      break;
+    case AdrMode::ABS_X:
+    case AdrMode::ABS_Y: {
+      std::string index = desc.mode == AdrMode::ABS_X ? "p.X" : "p.Y";
+      ea = "(word_t)(" + hex(abs, 4) + " + " + index + ")";
+      if (desc.page_penalty) {
+        out << "p.cycles += Processor::crosses_page(" << hex(abs, 4) << ", "
+            << ea << "); ";
+      }
+      break;
+    }
+    case AdrMode::X_IND:
+      ea = desc.mon == Mnemonic::STA
+               ? "p.zread_word(" + hex(lo, 2) + " + p.X)"
+               : "p.read_word((word_t)(" + hex(lo, 2) + " + p.X))";
+      break;
+    case AdrMode::IND_Y: {
+      std::string base = desc.mon == Mnemonic::STA
+                             ? "p.zread_word(" + hex(lo, 2) + ")"
+                             : "p.read_word(" + hex(lo, 2) + ")";
+      out << "word_t base = " << base << "; ";
+      ea = "(word_t)(base + p.Y)";
+      if (desc.page_penalty) {
+        out << "p.cycles += Processor::crosses_page(base, " << ea << "); ";
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  if (!ea.empty()) out << "word_t ea = " << ea << "; ";
+  std::string m = desc.mode == AdrMode::IMM ? hex(lo, 2) : "p.read(ea)";
+
+  auto rmw = [&](const std::string& op) {
+    if (desc.mode == AdrMode::A) {
+      out << "uint8_t& v = p.AC; " << op << update_nz("v");
+    } else {
+      out << "uint8_t v = p.read(ea); " << op << update_nz("v")
+          << "p.write(ea, v);";
+    }
+  };
+  auto compare = [&](const char* reg) {
+    out << "uint8_t m = " << m << "; uint8_t s = " << reg << " - m; "
+        << update_nz("s") << "p.SR.C = " << reg << " >= m;";
+  };
+  auto branch = [&](const char* test) {
+    out << "p.branch(" << test << ", " << hex(pc, 4) << "); return true;";
+    ends = true;
+  };
+
+  switch (desc.mon) {
+    case Mnemonic::LDA:
+      out << "p.AC = " << m << "; " << update_nz("p.AC");
+      break;
+    case Mnemonic::LDX:
+      out << "p.X = " << m << "; " << update_nz("p.X");
+      break;
+    case Mnemonic::LDY:
+      out << "p.Y = " << m << "; " << update_nz("p.Y");
+      break;
+    case Mnemonic::STA:
+      out << "p.write(ea, p.AC);";
+      break;
+    case Mnemonic::STX:
+      out << "p.write(ea, p.X);";
+      break;
+    case Mnemonic::STY:
+      out << "p.write(ea, p.Y);";
+      break;
+    case Mnemonic::TAX:
+      out << "p.X = p.AC; " << update_nz("p.X");
+      break;
+    case Mnemonic::TAY:
+      out << "p.Y = p.AC; " << update_nz("p.Y");
+      break;
+    case Mnemonic::TXA:
+      out << "p.AC = p.X; " << update_nz("p.AC");
+      break;
+    case Mnemonic::TXS:
+      out << "p.SP = p.X;";
+      break;
+    case Mnemonic::TYA:
+      out << "p.AC = p.Y; " << update_nz("p.AC");
+      break;
+    case Mnemonic::TSX:
+      out << "p.X = p.SP; " << update_nz("p.X");
+      break;
+    case Mnemonic::PHA:
+      out << "p.push(p.AC);";
+      break;
+    case Mnemonic::PHP:
+      out << "auto s = p.SR; s.B = 1; s._ = 1; p.push(s);";
+      break;
+    case Mnemonic::PLA:
+      out << "p.AC = p.pop(); " << update_nz("p.AC");
+      break;
+    case Mnemonic::DEC:
+      rmw("v--; ");
+      break;
+    case Mnemonic::INC:
+      rmw("v++; ");
+      break;
+    case Mnemonic::DEX:
+      out << "p.X--;";
+      break;
+    case Mnemonic::DEY:
+      out << "p.Y--;";
+      break;
+    case Mnemonic::INX:
+      out << "p.X++; " << update_nz("p.X");
+      break;
+    case Mnemonic::INY:
+      out << "p.Y++; " << update_nz("p.Y");
+      break;
+    case Mnemonic::ADC:
+    case Mnemonic::SBC:
+      out << "p.apply_arith(ArithTables::"
+          << (desc.mon == Mnemonic::ADC ? "ADC" : "SBC")
+          << "[ArithTables::index(p.SR.D, p.SR.C, p.AC, " << m << ")]);";
+      break;
+    case Mnemonic::AND:
+      out << "p.AC &= " << m << "; " << update_nz("p.AC");
+      break;
+    case Mnemonic::EOR:
+      out << "p.AC ^= " << m << "; " << update_nz("p.AC");
+      break;
+    case Mnemonic::ORA:
+      out << "p.AC |= " << m << "; " << update_nz("p.AC");
+      break;
+    case Mnemonic::ASL:
+      rmw("p.SR.C = v & 0x80; v <<= 1; ");
+      break;
+    case Mnemonic::LSR:
+      rmw("p.SR.C = v & 0x1; v >>= 1; ");
+      break;
+    case Mnemonic::ROL:
+      rmw("uint8_t old = v; v = (v << 1) | p.SR.C; p.SR.C = old & 0x80; ");
+      break;
+    case Mnemonic::ROR:
+      rmw("uint8_t old = v; v = (v >> 1) | (p.SR.C << 7); "
+          "p.SR.C = old & 0x1; ");
+      break;
+    case Mnemonic::CLC:
+      out << "p.SR.C = 0;";
+      break;
+    case Mnemonic::CLD:
+      out << "p.SR.D = 0;";
+      break;
+    case Mnemonic::CLI:
+      out << "p.SR.I = 0;";
+      break;
+    case Mnemonic::CLV:
+      out << "p.SR.V = 0;";
+      break;
+    case Mnemonic::SEC:
+      out << "p.SR.C = 1;";
+      break;
+    case Mnemonic::SED:
+      out << "p.SR.D = 1;";
+      break;
+    case Mnemonic::SEI:
+      out << "p.SR.I = 1;";
+      break;
+    case Mnemonic::CMP:
+      compare("p.AC");
+      break;
+    case Mnemonic::CPX:
+      compare("p.X");
+      break;
+    case Mnemonic::CPY:
+      compare("p.Y");
+      break;
+    case Mnemonic::BCC:
+      branch("!p.SR.C");
+      break;
+    case Mnemonic::BCS:
+      branch("p.SR.C");
+      break;
+    case Mnemonic::BEQ:
+      branch("p.SR.Z");
+      break;
+    case Mnemonic::BMI:
+      branch("p.SR.N");
+      break;
+    case Mnemonic::BNE:
+      branch("!p.SR.Z");
+      break;
+    case Mnemonic::BPL:
+      branch("!p.SR.N");
+      break;
+    case Mnemonic::BVC:
+      branch("!p.SR.V");
+      break;
+    case Mnemonic::BVS:
+      branch("p.SR.V");
+      break;
+    case Mnemonic::JMP:
+      if (desc.mode == AdrMode::IND) {
+        out << "p.PC = p.read_word(" << hex(abs, 4) << "); return true;";
+      } else {
+        out << "p.PC = " << hex(abs, 4) << "; return true;";
+      }
+      ends = true;
+      break;
+    case Mnemonic::JSR:
+      out << "p.push(" << hex((pc + 2) >> 8, 2) << "); p.push("
+          << hex((pc + 2) & 0xFF, 2) << "); p.PC = " << hex(abs, 4)
+          << "; return true;";
+      ends = true;
+      break;
+    case Mnemonic::RTS:
+      out << "p.PC = p.pop(); p.PC |= (word_t)p.pop() << 8; ++p.PC; "
+             "return true;";
+      ends = true;
+      break;
+    case Mnemonic::NOP:
+      // Only takes its cycles.
+      break;
+    case Mnemonic::BIT:
+      out << "uint8_t m = p.read(ea); p.SR.Z = (p.AC & m) == 0; "
+             "p.SR.V = m & 0x40; p.SR.N = m & 0x80;";
+      break;
+    default:
+      // is_interpreted() filters out everything else.
+      break;
+  }
+  return out.str();
+}
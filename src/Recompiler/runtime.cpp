@@ -0,0 +1,17 @@
+#include "Recompiler/runtime.h"
+
+uint8_t Recompiled::run(Processor& p) {
+  while (true) {
+    if (!p.check_for_interrupts()) return p.AC;
+    // Interrupts and waits are only noticed between blocks.
+    if (p.waiting) {
+      p.idle(UINT64_MAX, true);
+      continue;
+    }
+    Block next = lookup(p.PC);
+    if (next && next(p)) continue;
+    // Indirect jumps to untranslated code, modified code and anything the
+    // translator leaves to the interpreter.
+    if (!p.step()) return p.AC;
+  }
+}
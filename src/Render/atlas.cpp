@@ -0,0 +1,63 @@
+#include "Render/atlas.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "6502/InstructionSet/address_space.h"
+
+namespace {
+/// Display registers a frame depends on: mode, base and palette, which are
+/// contiguous in the IO page.
+constexpr word_t REGS_BEGIN = IO::display_mode;
+constexpr word_t REGS_END = IO::palette + 16;
+static_assert(IO::display_base > REGS_BEGIN && IO::display_base < REGS_END);
+
+/// Copy everything the frame of \p mem is drawn from into \p out.
+void gather_source(const uint8_t* mem, std::vector<uint8_t>& out) {
+  out.assign(mem + REGS_BEGIN, mem + REGS_END);
+  const DisplayModeDesc& desc =
+      FrameExpander::describe(mem[IO::display_mode]);
+  size_t start = FrameExpander::framebuffer_start(mem);
+  size_t head = std::min(desc.bytes(), ADDR_SPACE_SZ - start);
+  out.insert(out.end(), mem + start, mem + start + head);
+  out.insert(out.end(), mem, mem + desc.bytes() - head);
+}
+}  // namespace
+
+TileAtlas::TileAtlas(size_t tiles)
+    : cols(std::max(1, (int)std::ceil(std::sqrt((double)tiles)))),
+      slots(tiles),
+      frame(FrameExpander::MAX_WIDTH * FrameExpander::MAX_HEIGHT) {
+  for (Slot& slot : slots) slot.pixels.resize(TILE_SIZE * TILE_SIZE);
+}
+
+bool TileAtlas::update(size_t tile, const uint8_t* mem) {
+  Slot& slot = slots[tile];
+  // Compare in place first, so unchanged tiles cost no copy.
+  const DisplayModeDesc& mode = FrameExpander::describe(mem[IO::display_mode]);
+  size_t start = FrameExpander::framebuffer_start(mem);
+  size_t regs = REGS_END - REGS_BEGIN;
+  size_t head = std::min(mode.bytes(), ADDR_SPACE_SZ - start);
+  if (slot.source.size() == regs + mode.bytes() &&
+      !memcmp(slot.source.data(), mem + REGS_BEGIN, regs) &&
+      !memcmp(slot.source.data() + regs, mem + start, head) &&
+      !memcmp(slot.source.data() + regs + head, mem, mode.bytes() - head)) {
+    return false;
+  }
+  gather_source(mem, slot.source);
+
+  const DisplayModeDesc& desc = slot.expander.expand(mem, frame.data());
+  // Nearest neighbour scaling by a whole factor, one source row at a time.
+  int scale = TILE_SIZE / desc.width;
+  for (int row = 0; row < desc.height; row++) {
+    const uint32_t* src = frame.data() + row * desc.width;
+    uint32_t* dst = slot.pixels.data() + row * scale * TILE_SIZE;
+    for (int col = 0; col < desc.width; col++) {
+      for (int i = 0; i < scale; i++) dst[col * scale + i] = src[col];
+    }
+    for (int i = 1; i < scale; i++) {
+      memcpy(dst + i * TILE_SIZE, dst, TILE_SIZE * sizeof(uint32_t));
+    }
+  }
+  return true;
+}
@@ -0,0 +1,152 @@
+#include "Render/capture.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "Render/png.h"
+
+namespace {
+constexpr word_t STREAM_WIDTH = FrameExpander::MAX_WIDTH;
+constexpr word_t STREAM_HEIGHT = FrameExpander::MAX_HEIGHT;
+
+CaptureFormat format_of(const std::string& path) {
+  std::string ext = std::filesystem::path(path).extension();
+  if (ext == ".y4m") return CaptureFormat::Y4M;
+  if (ext == ".rgba") return CaptureFormat::RAW;
+  return CaptureFormat::PNG;
+}
+
+/// Scale \p rgba up to the stream size by repeating pixels.
+void scale_to_stream(const uint32_t* rgba, word_t width, word_t height,
+                     uint32_t* out) {
+  for (word_t y = 0; y < STREAM_HEIGHT; y++) {
+    const uint32_t* row = rgba + y * height / STREAM_HEIGHT * width;
+    for (word_t x = 0; x < STREAM_WIDTH; x++) {
+      out[y * STREAM_WIDTH + x] = row[x * width / STREAM_WIDTH];
+    }
+  }
+}
+
+/// Convert to BT.601 studio range Y, Cb and Cr planes.
+void to_yuv444(const uint32_t* rgba, size_t n, uint8_t* planes) {
+  for (size_t i = 0; i < n; i++) {
+    int r = rgba[i] & 0xFF;
+    int g = rgba[i] >> 8 & 0xFF;
+    int b = rgba[i] >> 16 & 0xFF;
+    planes[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    planes[n + i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    planes[2 * n + i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  }
+}
+}  // namespace
+
+FrameCapture::FrameCapture(const std::string& path, size_t slots)
+    : format(format_of(path)), path(path), ring(slots) {
+  for (Frame& frame : ring) {
+    frame.rgba.resize(FrameExpander::MAX_WIDTH * FrameExpander::MAX_HEIGHT);
+  }
+  if (format == CaptureFormat::PNG) {
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    ok = !error;
+  } else {
+    stream.open(path, std::ios::binary);
+    ok = stream.good();
+  }
+  if (!ok) {
+    std::cerr << path << ": can't write frames there" << std::endl;
+    return;
+  }
+  if (format == CaptureFormat::Y4M) {
+    stream << "YUV4MPEG2 W" << STREAM_WIDTH << " H" << STREAM_HEIGHT
+           << " F60:1 Ip A1:1 C444\n";
+  }
+  encoder = std::thread(&FrameCapture::encode_loop, this);
+}
+
+FrameCapture::~FrameCapture() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  ready.notify_one();
+  if (encoder.joinable()) encoder.join();
+}
+
+bool FrameCapture::push(const DisplayModeDesc& mode, const uint32_t* rgba) {
+  if (!ok) return false;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (queued == ring.size()) {
+      ++dropped;
+      return false;
+    }
+    // The encoder never touches slots outside [head, head + queued).
+    Frame& frame = ring[(head + queued) % ring.size()];
+    frame.width = mode.width;
+    frame.height = mode.height;
+    memcpy(frame.rgba.data(), rgba,
+           (size_t)mode.width * mode.height * sizeof(uint32_t));
+    ++queued;
+  }
+  ready.notify_one();
+  return true;
+}
+
+void FrameCapture::encode_loop() {
+  for (uint64_t index = 0;; index++) {
+    std::unique_lock<std::mutex> guard(lock);
+    ready.wait(guard, [this] { return queued || stopping; });
+    if (!queued) return;
+    const Frame& frame = ring[head];
+    // The slot stays queued while it's written, so it can't be reused.
+    guard.unlock();
+    write(frame, index);
+    ++written;
+    guard.lock();
+    head = (head + 1) % ring.size();
+    --queued;
+  }
+}
+
+void FrameCapture::write(const Frame& frame, uint64_t index) {
+  if (format == CaptureFormat::PNG) {
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%06llu.png", (unsigned long long)index);
+    write_png(std::filesystem::path(path) / name, frame.rgba.data(),
+              frame.width, frame.height);
+    return;
+  }
+
+  std::vector<uint32_t> scaled(STREAM_WIDTH * STREAM_HEIGHT);
+  scale_to_stream(frame.rgba.data(), frame.width, frame.height, scaled.data());
+  if (format == CaptureFormat::RAW) {
+    stream.write(reinterpret_cast<const char*>(scaled.data()),
+                 scaled.size() * sizeof(uint32_t));
+  } else {
+    std::vector<uint8_t> planes(scaled.size() * 3);
+    to_yuv444(scaled.data(), scaled.size(), planes.data());
+    stream << "FRAME\n";
+    stream.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+  }
+}
+
+void capture_loop(Processor& proc, FrameCapture& capture, uint64_t frames) {
+  using clock = std::chrono::steady_clock;
+  constexpr auto FRAME_TIME = std::chrono::microseconds(1000000 / 60);
+
+  FrameExpander expander;
+  std::vector<uint32_t> pixels(FrameExpander::MAX_WIDTH *
+                               FrameExpander::MAX_HEIGHT);
+  auto next = clock::now();
+  for (uint64_t frame = 0; !frames || frame < frames; frame++) {
+    if (capture.closed()) return;
+    next += FRAME_TIME;
+    std::this_thread::sleep_until(next);
+    capture.push(expander.expand(proc.memory(), pixels.data()), pixels.data());
+    proc.post(HostEvent::vsync());
+  }
+  proc.post(HostEvent::stop());
+}
@@ -0,0 +1,97 @@
+#include "Render/framebuffer.h"
+
+#include <cstring>
+
+#include "6502/InstructionSet/address_space.h"
+
+namespace {
+constexpr DisplayModeDesc MODES[] = {
+#define DISPLAY_MODE(name, code, width, height, bpp) \
+  {DisplayMode::name, width, height, bpp},
+#include "Render/displaymodes.def"
+};
+
+constexpr uint32_t BLACK = 0xFF000000;
+constexpr uint32_t WHITE = 0xFFFFFFFF;
+
+/// RGBA value of a palette entry, which is stored as RGB332.
+uint32_t from_rgb332(uint8_t c) {
+  uint32_t r = (c >> 5) * 255 / 7;
+  uint32_t g = (c >> 2 & 7) * 255 / 7;
+  uint32_t b = (c & 3) * 255 / 3;
+  return r | g << 8 | b << 16 | BLACK;
+}
+
+/// Expand \p n framebuffer bytes at \p fb into \p out using \p table.
+template <int BPP>
+void expand_bytes(const uint8_t* fb, size_t n,
+                  const std::array<std::array<uint32_t, 8>, 256>& table,
+                  uint32_t* out) {
+  constexpr int PER_BYTE = 8 / BPP;
+  for (size_t i = 0; i < n; i++) {
+    memcpy(out + i * PER_BYTE, table[fb[i]].data(),
+           PER_BYTE * sizeof(uint32_t));
+  }
+}
+}  // namespace
+
+const DisplayModeDesc& FrameExpander::describe(uint8_t code) {
+  for (const DisplayModeDesc& desc : MODES) {
+    if ((uint8_t)desc.mode == code) return desc;
+  }
+  return MODES[0];
+}
+
+size_t FrameExpander::framebuffer_start(const uint8_t* mem) {
+  uint8_t page = mem[IO::display_base];
+  return (page ? page : Regions::DISPLAY.begin >> 8) * PAGE_SZ;
+}
+
+void FrameExpander::rebuild(const DisplayModeDesc& desc,
+                            const uint8_t* palette) {
+  bool mono = desc.mode == DisplayMode::MONO_64;
+  uint8_t mask = (1 << desc.bpp) - 1;
+  for (int byte = 0; byte < 256; byte++) {
+    for (int px = 0; px < 8 / desc.bpp; px++) {
+      uint8_t index = byte >> (8 - desc.bpp * (px + 1)) & mask;
+      table[byte][px] = mono ? (index ? WHITE : BLACK)
+                             : from_rgb332(palette[index]);
+    }
+  }
+  built_mode = (int)desc.mode;
+  memcpy(built_palette.data(), palette, built_palette.size());
+}
+
+const DisplayModeDesc& FrameExpander::expand(const uint8_t* mem,
+                                             uint32_t* rgba) {
+  const DisplayModeDesc& desc = describe(mem[IO::display_mode]);
+  const uint8_t* palette = mem + IO::palette;
+  if ((int)desc.mode != built_mode ||
+      (desc.mode != DisplayMode::MONO_64 &&
+       memcmp(palette, built_palette.data(), built_palette.size()))) {
+    rebuild(desc, palette);
+  }
+
+  size_t start = framebuffer_start(mem);
+  const uint8_t* fb = mem + start;
+  uint8_t wrapped[MAX_WIDTH * MAX_HEIGHT / 2];
+  if (start + desc.bytes() > ADDR_SPACE_SZ) {
+    size_t head = ADDR_SPACE_SZ - start;
+    memcpy(wrapped, fb, head);
+    memcpy(wrapped + head, mem, desc.bytes() - head);
+    fb = wrapped;
+  }
+
+  switch (desc.bpp) {
+    case 1:
+      expand_bytes<1>(fb, desc.bytes(), table, rgba);
+      break;
+    case 2:
+      expand_bytes<2>(fb, desc.bytes(), table, rgba);
+      break;
+    case 4:
+      expand_bytes<4>(fb, desc.bytes(), table, rgba);
+      break;
+  }
+  return desc;
+}
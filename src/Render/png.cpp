@@ -0,0 +1,88 @@
+#include "Render/png.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+namespace {
+uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t;
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+  }
+  return ~crc;
+}
+
+void put_be32(std::vector<uint8_t>& out, uint32_t v) {
+  for (int shift = 24; shift >= 0; shift -= 8) out.push_back(v >> shift);
+}
+
+void put_chunk(std::vector<uint8_t>& out, const char* type,
+               const std::vector<uint8_t>& data) {
+  put_be32(out, data.size());
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  put_be32(out, crc32(out.data() + start, out.size() - start));
+}
+
+}  // namespace
+
+std::vector<uint8_t> encode_png(const uint32_t* rgba, word_t width,
+                                word_t height) {
+  std::vector<uint8_t> rows;
+  rows.reserve((width * 4 + 1) * height);
+  for (word_t y = 0; y < height; y++) {
+    rows.push_back(0);  // No filter.
+    const uint8_t* row = reinterpret_cast<const uint8_t*>(rgba + y * width);
+    rows.insert(rows.end(), row, row + width * 4);
+  }
+
+  std::vector<uint8_t> zlib = {0x78, 0x01};
+  for (size_t at = 0; at < rows.size();) {
+    uint16_t len = std::min<size_t>(rows.size() - at, UINT16_MAX);
+    bool last = at + len == rows.size();
+    zlib.push_back(last);
+    zlib.push_back(len & 0xFF);
+    zlib.push_back(len >> 8);
+    zlib.push_back(~len & 0xFF);
+    zlib.push_back((uint16_t)~len >> 8);
+    zlib.insert(zlib.end(), rows.begin() + at, rows.begin() + at + len);
+    at += len;
+  }
+  uint32_t a = 1, b = 0;
+  for (uint8_t byte : rows) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  put_be32(zlib, b << 16 | a);
+
+  std::vector<uint8_t> header;
+  put_be32(header, width);
+  put_be32(header, height);
+  // 8 bits per channel, RGBA, deflate, no filtering scheme, no interlace.
+  header.insert(header.end(), {8, 6, 0, 0, 0});
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  put_chunk(png, "IHDR", header);
+  put_chunk(png, "IDAT", zlib);
+  put_chunk(png, "IEND", {});
+  return png;
+}
+
+bool write_png(const std::string& path, const uint32_t* rgba, word_t width,
+               word_t height) {
+  std::vector<uint8_t> png = encode_png(rgba, width, height);
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(png.data()), png.size());
+  return out.good();
+}
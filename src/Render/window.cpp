@@ -0,0 +1,113 @@
+#include "Render/window.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "Render/atlas.h"
+#include "Render/capture.h"
+#include "Render/framebuffer.h"
+#include "raylib.h"
+
+namespace {
+/// A texture of \p width by \p height RGBA pixels.
+Texture2D make_texture(int width, int height) {
+  Image blank = GenImageColor(width, height, BLACK);
+  Texture2D texture = LoadTextureFromImage(blank);
+  UnloadImage(blank);
+  return texture;
+}
+}  // namespace
+
+void draw_loop(Processor &proc, FrameCapture *capture) {
+  SetTraceLogLevel(LOG_ERROR);
+  constexpr int WINDOW_SIZE = 1024;
+#ifdef SFEM_HEATMAP
+  // The heatmap goes to the right of the display, at twice its size.
+  constexpr int HEATMAP_SIZE = AccessHeatmap::SIDE * 2;
+  InitWindow(WINDOW_SIZE + HEATMAP_SIZE, WINDOW_SIZE, "[6502]");
+  std::vector<uint32_t> heat_pixels(AccessHeatmap::SIDE * AccessHeatmap::SIDE);
+  Texture2D heat_texture =
+      make_texture(AccessHeatmap::SIDE, AccessHeatmap::SIDE);
+#else
+  InitWindow(WINDOW_SIZE, WINDOW_SIZE, "[6502]");
+#endif
+  SetTargetFPS(60);
+
+  FrameExpander expander;
+  std::vector<uint32_t> pixels(FrameExpander::MAX_WIDTH *
+                               FrameExpander::MAX_HEIGHT);
+  Texture2D texture = make_texture(Display::width, Display::height);
+  int mouse_x = -1;
+  int mouse_y = -1;
+  while (!WindowShouldClose()) {
+    // Only changes are posted, so idle sessions record nothing.
+    int col = std::min(GetMouseX(), WINDOW_SIZE - 1) * texture.width /
+              WINDOW_SIZE;
+    int row = GetMouseY() * texture.height / WINDOW_SIZE;
+    if (col != mouse_x) proc.post(HostEvent::io_write(IO::mouse_x, col));
+    if (row != mouse_y) proc.post(HostEvent::io_write(IO::mouse_y, row));
+    mouse_x = col;
+    mouse_y = row;
+
+    const DisplayModeDesc &mode = expander.expand(proc.memory(), pixels.data());
+    if (mode.width != texture.width || mode.height != texture.height) {
+      UnloadTexture(texture);
+      texture = make_texture(mode.width, mode.height);
+    }
+    UpdateTexture(texture, pixels.data());
+    if (capture) capture->push(mode, pixels.data());
+
+    BeginDrawing();
+    ClearBackground(BLACK);
+    Rectangle source{0, 0, (float)texture.width, (float)texture.height};
+    Rectangle dest{0, 0, WINDOW_SIZE, WINDOW_SIZE};
+    DrawTexturePro(texture, source, dest, Vector2{0, 0}, 0, WHITE);
+#ifdef SFEM_HEATMAP
+    proc.heatmap().to_rgba(heat_pixels.data());
+    UpdateTexture(heat_texture, heat_pixels.data());
+    DrawTextureEx(heat_texture, Vector2{WINDOW_SIZE, 0}, 0, 2, WHITE);
+#endif
+    EndDrawing();
+    proc.post(HostEvent::vsync());
+  }
+  UnloadTexture(texture);
+#ifdef SFEM_HEATMAP
+  UnloadTexture(heat_texture);
+#endif
+  CloseWindow();
+  proc.post(HostEvent::stop());
+}
+
+void grid_loop(const std::vector<Processor *> &procs) {
+  SetTraceLogLevel(LOG_ERROR);
+  TileAtlas atlas(procs.size());
+  // Fit the grid in about the size of the single machine window.
+  constexpr int WINDOW_SIZE = 1024;
+  int tile = std::max(WINDOW_SIZE / std::max(atlas.columns(), atlas.rows()),
+                      16);
+  InitWindow(tile * atlas.columns(), tile * atlas.rows(), "[6502 x N]");
+  SetTargetFPS(60);
+
+  Texture2D texture = make_texture(atlas.width(), atlas.height());
+  while (!WindowShouldClose()) {
+    for (size_t i = 0; i < procs.size(); i++) {
+      if (!atlas.update(i, procs[i]->memory())) continue;
+      Rectangle rect{(float)atlas.x(i), (float)atlas.y(i),
+                     TileAtlas::TILE_SIZE, TileAtlas::TILE_SIZE};
+      UpdateTextureRec(texture, rect, atlas.pixels(i));
+    }
+
+    BeginDrawing();
+    ClearBackground(BLACK);
+    Rectangle source{0, 0, (float)atlas.width(), (float)atlas.height()};
+    Rectangle dest{0, 0, (float)tile * atlas.columns(),
+                   (float)tile * atlas.rows()};
+    DrawTexturePro(texture, source, dest, Vector2{0, 0}, 0, WHITE);
+    EndDrawing();
+    for (Processor *proc : procs) proc->post(HostEvent::vsync());
+  }
+  UnloadTexture(texture);
+  CloseWindow();
+  for (Processor *proc : procs) proc->post(HostEvent::stop());
+}
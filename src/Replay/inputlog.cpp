@@ -0,0 +1,87 @@
+#include "Replay/inputlog.h"
+
+#include <cstring>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+
+namespace {
+constexpr char MAGIC[8] = {'S', 'F', 'E', 'M', 'R', 'E', 'C', '\0'};
+constexpr uint32_t VERSION = 1;
+
+template <typename T>
+void put(std::ostream& out, T value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value) {
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+}  // namespace
+
+InputRecorder::InputRecorder(const std::string& path,
+                             const std::vector<uint8_t>& image)
+    : out(path, std::ios::binary) {
+  out.write(MAGIC, sizeof(MAGIC));
+  put(out, VERSION);
+  out.write(reinterpret_cast<const char*>(image.data()), ADDR_SPACE_SZ);
+}
+
+void InputRecorder::append(uint64_t cycle, const HostEvent& event) {
+  put(out, cycle);
+  put(out, static_cast<uint8_t>(event.kind));
+  put(out, event.addr);
+  put(out, event.value);
+  if (event.kind == HostEvent::Kind::RELOAD) {
+    out.write(reinterpret_cast<const char*>(event.image->data()),
+              ADDR_SPACE_SZ);
+  }
+}
+
+bool InputLog::load(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(MAGIC)];
+  uint32_t version;
+  if (!in.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) ||
+      !get(in, version) || version != VERSION) {
+    return false;
+  }
+  initial_image.resize(ADDR_SPACE_SZ);
+  if (!in.read(reinterpret_cast<char*>(initial_image.data()), ADDR_SPACE_SZ)) {
+    return false;
+  }
+
+  logged.clear();
+  uint64_t cycle;
+  while (get(in, cycle)) {
+    uint8_t kind;
+    HostEvent event{};
+    if (!get(in, kind) || !get(in, event.addr) || !get(in, event.value)) {
+      return false;
+    }
+    event.kind = static_cast<HostEvent::Kind>(kind);
+    if (event.kind == HostEvent::Kind::RELOAD) {
+      std::vector<uint8_t> image(ADDR_SPACE_SZ);
+      if (!in.read(reinterpret_cast<char*>(image.data()), ADDR_SPACE_SZ)) {
+        return false;
+      }
+      event.image =
+          std::make_shared<const std::vector<uint8_t>>(std::move(image));
+    }
+    logged.push_back({cycle, event});
+  }
+  return true;
+}
+
+bool replay(Processor& proc, const InputLog& log) {
+  for (const LoggedEvent& logged : log.events()) {
+    // Events are applied at the first instruction boundary at or after their
+    // cycle, which is exactly where they were applied when recording.
+    if (!proc.run_until(logged.cycle)) return false;
+    if (logged.event.kind == HostEvent::Kind::STOP) return true;
+    proc.post(logged.event);
+  }
+  return true;
+}
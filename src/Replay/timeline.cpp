@@ -0,0 +1,186 @@
+#include "Replay/timeline.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+constexpr char MAGIC[8] = {'S', 'F', 'E', 'M', 'T', 'L', 'N', '\0'};
+constexpr char INDEX_MAGIC[8] = {'S', 'F', 'E', 'M', 'T', 'I', 'D', 'X'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SZ = sizeof(MAGIC) + sizeof(VERSION);
+/// Cycle, vsync count, registers and page count.
+constexpr size_t FRAME_HEADER_SZ = 8 + 8 + 2 + 5 + 2;
+/// Index offset, frame count and magic.
+constexpr size_t TRAILER_SZ = 8 + 8 + sizeof(INDEX_MAGIC);
+
+template <typename T>
+void put(std::ostream& out, T value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/// Read a \p T at \p at, which needn't be aligned.
+template <typename T>
+T get(const uint8_t* at) {
+  T value;
+  memcpy(&value, at, sizeof(T));
+  return value;
+}
+}  // namespace
+
+TimelineRecorder::TimelineRecorder(const std::string& path)
+    : out(path, std::ios::binary) {
+  if (!out) {
+    std::cerr << path << ": can't write timeline: " << strerror(errno)
+              << std::endl;
+    return;
+  }
+  out.write(MAGIC, sizeof(MAGIC));
+  put(out, VERSION);
+}
+
+TimelineRecorder::~TimelineRecorder() { close(); }
+
+void TimelineRecorder::append(const Processor& proc) {
+  const uint8_t* mem = proc.memory();
+  uint8_t changed[NUM_PAGES];
+  uint16_t count = 0;
+  for (size_t page = 0; page < NUM_PAGES; page++) {
+    if (last.empty() ||
+        memcmp(mem + page * PAGE_SZ, last.data() + page * PAGE_SZ, PAGE_SZ)) {
+      changed[count++] = page;
+    }
+  }
+
+  offsets.push_back(out.tellp());
+  Processor::Registers regs = proc.registers();
+  put(out, proc.cycle_count());
+  put(out, proc.vsync_count());
+  put(out, regs.PC);
+  for (uint8_t reg : {regs.AC, regs.X, regs.Y, regs.SR, regs.SP}) {
+    put(out, reg);
+  }
+  put(out, count);
+  out.write(reinterpret_cast<const char*>(changed), count);
+  for (uint16_t i = 0; i < count; i++) {
+    out.write(reinterpret_cast<const char*>(mem) + changed[i] * PAGE_SZ,
+              PAGE_SZ);
+  }
+  last.assign(mem, mem + ADDR_SPACE_SZ);
+}
+
+void TimelineRecorder::close() {
+  if (!out.is_open()) return;
+  uint64_t index = out.tellp();
+  for (uint64_t offset : offsets) put(out, offset);
+  put(out, index);
+  put(out, (uint64_t)offsets.size());
+  out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  out.close();
+}
+
+Timeline::~Timeline() {
+  if (map) munmap(const_cast<uint8_t*>(map), map_size);
+}
+
+size_t Timeline::parse_frame(size_t offset) {
+  if (map_size - offset < FRAME_HEADER_SZ) return 0;
+  const uint8_t* at = map + offset;
+  Frame frame;
+  frame.cycle = get<uint64_t>(at);
+  frame.vsync = get<uint64_t>(at + 8);
+  frame.regs = {get<word_t>(at + 16), at[18], at[19], at[20], at[21], at[22]};
+  uint16_t count = get<uint16_t>(at + 23);
+  size_t end = offset + FRAME_HEADER_SZ + count + (size_t)count * PAGE_SZ;
+  if (count > NUM_PAGES || end > map_size) return 0;
+  // The first frame must hold every page, so that every byte has a value.
+  if (frames.empty() && count != NUM_PAGES) return 0;
+
+  const uint8_t* numbers = at + FRAME_HEADER_SZ;
+  const uint8_t* data = numbers + count;
+  for (uint16_t i = 0; i < count; i++) {
+    pages[numbers[i]].push_back({(uint32_t)frames.size(), data + i * PAGE_SZ});
+  }
+  frames.push_back(frame);
+  return end;
+}
+
+bool Timeline::load(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "open failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    std::cerr << "fstat failed: " << strerror(errno) << std::endl;
+    ::close(fd);
+    return false;
+  }
+  map_size = st.st_size;
+  void* mem = map_size ? mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0)
+                       : MAP_FAILED;
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    if (map_size) std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+  map = static_cast<const uint8_t*>(mem);
+  if (map_size < HEADER_SZ || memcmp(map, MAGIC, sizeof(MAGIC)) ||
+      get<uint32_t>(map + sizeof(MAGIC)) != VERSION) {
+    return false;
+  }
+
+  // Follow the index when there is one, else walk the frames from the start.
+  indexed = map_size >= HEADER_SZ + TRAILER_SZ &&
+            !memcmp(map + map_size - sizeof(INDEX_MAGIC), INDEX_MAGIC,
+                    sizeof(INDEX_MAGIC));
+  if (indexed) {
+    const uint8_t* trailer = map + map_size - TRAILER_SZ;
+    uint64_t index = get<uint64_t>(trailer);
+    uint64_t count = get<uint64_t>(trailer + 8);
+    if (index > map_size - TRAILER_SZ ||
+        count > (map_size - TRAILER_SZ - index) / sizeof(uint64_t)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+      uint64_t offset = get<uint64_t>(map + index + i * sizeof(uint64_t));
+      if (offset > index || !parse_frame(offset)) return false;
+    }
+  } else {
+    for (size_t offset = HEADER_SZ; offset;) offset = parse_frame(offset);
+  }
+  return !frames.empty();
+}
+
+std::vector<Timeline::PageVersion>::const_iterator Timeline::after(
+    uint8_t page, size_t i) const {
+  return std::upper_bound(
+      pages[page].begin(), pages[page].end(), i,
+      [](size_t i, const PageVersion& v) { return i < v.frame; });
+}
+
+uint8_t Timeline::byte(word_t addr, size_t i) const {
+  // The first frame stores every page, so there's always a version before.
+  return (after(addr / PAGE_SZ, i) - 1)->data[addr % PAGE_SZ];
+}
+
+std::optional<size_t> Timeline::first_change(word_t addr, size_t from) const {
+  uint8_t initial = byte(addr, from);
+  uint8_t page = addr / PAGE_SZ;
+  for (auto v = after(page, from); v != pages[page].end(); ++v) {
+    if (v->data[addr % PAGE_SZ] != initial) return v->frame;
+  }
+  return std::nullopt;
+}
+
+std::vector<size_t> Timeline::candidates(word_t addr) const {
+  std::vector<size_t> stored;
+  for (const PageVersion& v : pages[addr / PAGE_SZ]) stored.push_back(v.frame);
+  return stored;
+}
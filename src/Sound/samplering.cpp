@@ -0,0 +1,31 @@
+#include "Sound/samplering.h"
+
+#include <algorithm>
+#include <bit>
+
+SampleRing::SampleRing(size_t capacity)
+    : samples(std::bit_ceil(capacity)), mask(samples.size() - 1) {}
+
+size_t SampleRing::push(const int16_t* in, size_t n) {
+  size_t h = head.load(std::memory_order_relaxed);
+  size_t t = tail.load(std::memory_order_acquire);
+  size_t count = std::min(n, samples.size() - (h - t));
+  for (size_t i = 0; i < count; i++) samples[(h + i) & mask] = in[i];
+  head.store(h + count, std::memory_order_release);
+  if (count < n) drops.fetch_add(n - count, std::memory_order_relaxed);
+  return count;
+}
+
+size_t SampleRing::pop(int16_t* out, size_t n) {
+  size_t t = tail.load(std::memory_order_relaxed);
+  size_t h = head.load(std::memory_order_acquire);
+  size_t count = std::min(n, h - t);
+  for (size_t i = 0; i < count; i++) out[i] = samples[(t + i) & mask];
+  tail.store(t + count, std::memory_order_release);
+  return count;
+}
+
+size_t SampleRing::available() const {
+  return head.load(std::memory_order_acquire) -
+         tail.load(std::memory_order_acquire);
+}
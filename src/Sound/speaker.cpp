@@ -0,0 +1,50 @@
+#include "Sound/speaker.h"
+
+#include <chrono>
+#include <vector>
+
+#include "Sound/samplering.h"
+#include "raylib.h"
+
+namespace {
+/// Samples handed to raylib at a time. Smaller means lower latency, at the
+/// risk of gaps when this thread is scheduled late.
+constexpr int CHUNK = 1024;
+}  // namespace
+
+bool Speaker::available() {
+  InitAudioDevice();
+  bool ready = IsAudioDeviceReady();
+  CloseAudioDevice();
+  return ready;
+}
+
+Speaker::Speaker(SampleRing& ring, uint32_t rate) : ring(ring), rate(rate) {
+  player = std::thread(&Speaker::play, this);
+}
+
+Speaker::~Speaker() {
+  stopping = true;
+  player.join();
+}
+
+void Speaker::play() {
+  SetAudioStreamBufferSizeDefault(CHUNK);
+  InitAudioDevice();
+  AudioStream stream = LoadAudioStream(rate, 16, 1);
+  PlayAudioStream(stream);
+  std::vector<int16_t> chunk(CHUNK);
+  int16_t held = 0;
+  while (!stopping) {
+    if (!IsAudioStreamProcessed(stream)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      continue;
+    }
+    size_t n = ring.pop(chunk.data(), chunk.size());
+    if (n) held = chunk[n - 1];
+    std::fill(chunk.begin() + n, chunk.end(), held);
+    UpdateAudioStream(stream, chunk.data(), CHUNK);
+  }
+  UnloadAudioStream(stream);
+  CloseAudioDevice();
+}
@@ -0,0 +1,77 @@
+#include "Sound/wavwriter.h"
+
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <iostream>
+
+#include "Sound/samplering.h"
+
+namespace {
+void put_u16(std::ostream& os, uint16_t v) {
+  char bytes[] = {(char)(v & 0xFF), (char)(v >> 8)};
+  os.write(bytes, sizeof(bytes));
+}
+
+void put_u32(std::ostream& os, uint32_t v) {
+  put_u16(os, v & 0xFFFF);
+  put_u16(os, v >> 16);
+}
+}  // namespace
+
+WavWriter::WavWriter(const std::string& path, SampleRing& ring, uint32_t rate)
+    : ring(ring), out(path, std::ios::binary), rate(rate) {
+  if (!out) {
+    std::cerr << path << ": can't write audio: " << strerror(errno)
+              << std::endl;
+    return;
+  }
+  // Sizes are filled in once known.
+  write_header();
+  drainer = std::thread(&WavWriter::drain, this);
+}
+
+WavWriter::~WavWriter() { finish(); }
+
+void WavWriter::write_header() {
+  constexpr uint16_t CHANNELS = 1;
+  constexpr uint16_t BITS = 16;
+  uint32_t data_bytes = written * sizeof(int16_t);
+  out.seekp(0);
+  out.write("RIFF", 4);
+  put_u32(out, 36 + data_bytes);
+  out.write("WAVEfmt ", 8);
+  put_u32(out, 16);
+  put_u16(out, 1);  // PCM
+  put_u16(out, CHANNELS);
+  put_u32(out, rate);
+  put_u32(out, rate * CHANNELS * BITS / 8);
+  put_u16(out, CHANNELS * BITS / 8);
+  put_u16(out, BITS);
+  out.write("data", 4);
+  put_u32(out, data_bytes);
+}
+
+void WavWriter::drain() {
+  int16_t samples[4096];
+  for (;;) {
+    // Check before popping, so that nothing pushed before close is missed.
+    bool last = ring.closed();
+    size_t n;
+    while ((n = ring.pop(samples, std::size(samples)))) {
+      // WAV samples are little endian, like the host.
+      out.write(reinterpret_cast<const char*>(samples), n * sizeof(int16_t));
+      written += n;
+    }
+    if (last) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void WavWriter::finish() {
+  if (!drainer.joinable()) return;
+  ring.close();
+  drainer.join();
+  write_header();
+  out.close();
+}
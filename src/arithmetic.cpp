@@ -0,0 +1,70 @@
+#include "6502/InstructionSet/arithmetic.h"
+
+namespace {
+// Flag positions inside the status register.
+constexpr uint8_t FLAG_C = 1 << 0;
+constexpr uint8_t FLAG_Z = 1 << 1;
+constexpr uint8_t FLAG_V = 1 << 6;
+constexpr uint8_t FLAG_N = 1 << 7;
+
+uint16_t pack(uint8_t result, bool c, bool z, bool v, bool n) {
+  uint8_t flags = (c ? FLAG_C : 0) | (z ? FLAG_Z : 0) | (v ? FLAG_V : 0) |
+                  (n ? FLAG_N : 0);
+  return static_cast<uint16_t>(flags) << 8 | result;
+}
+
+uint16_t binary_adc(uint8_t a, uint8_t b, bool c) {
+  unsigned sum = a + b + c;
+  uint8_t result = sum & 0xFF;
+  bool v = ~(a ^ b) & (a ^ result) & 0x80;
+  return pack(result, sum > 0xFF, result == 0, v, result & 0x80);
+}
+
+/// Decimal mode follows the NMOS 6502: N and V are taken from the sum before
+/// the high nibble is adjusted, and Z reflects the binary result.
+uint16_t decimal_adc(uint8_t a, uint8_t b, bool c) {
+  int lo = (a & 0x0F) + (b & 0x0F) + c;
+  if (lo >= 0x0A) lo = ((lo + 0x06) & 0x0F) + 0x10;
+  int sum = (a & 0xF0) + (b & 0xF0) + lo;
+  bool n = sum & 0x80;
+  bool v = ~(a ^ b) & (a ^ sum) & 0x80;
+  if (sum >= 0xA0) sum += 0x60;
+  bool z = ((a + b + c) & 0xFF) == 0;
+  return pack(sum & 0xFF, sum >= 0x100, z, v, n);
+}
+
+/// Subtraction is addition of the one's complement operand.
+uint16_t binary_sbc(uint8_t a, uint8_t b, bool c) {
+  return binary_adc(a, ~b, c);
+}
+
+/// On the NMOS 6502 every SBC flag comes from the binary subtraction, only the
+/// accumulator gets the decimal correction.
+uint16_t decimal_sbc(uint8_t a, uint8_t b, bool c) {
+  uint16_t flags = binary_sbc(a, b, c) & 0xFF00;
+  int lo = (a & 0x0F) - (b & 0x0F) + c - 1;
+  if (lo < 0) lo = ((lo - 0x06) & 0x0F) - 0x10;
+  int diff = (a & 0xF0) - (b & 0xF0) + lo;
+  if (diff < 0) diff -= 0x60;
+  return flags | (diff & 0xFF);
+}
+
+template <typename F>
+ArithTables::Table build(F binary, F decimal) {
+  ArithTables::Table table;
+  for (int d = 0; d < 2; d++) {
+    for (int c = 0; c < 2; c++) {
+      for (int a = 0; a < 256; a++) {
+        for (int b = 0; b < 256; b++) {
+          table[ArithTables::index(d, c, a, b)] =
+              d ? decimal(a, b, c) : binary(a, b, c);
+        }
+      }
+    }
+  }
+  return table;
+}
+}  // namespace
+
+const ArithTables::Table ArithTables::ADC = build(binary_adc, decimal_adc);
+const ArithTables::Table ArithTables::SBC = build(binary_sbc, decimal_sbc);
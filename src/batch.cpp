@@ -0,0 +1,480 @@
+#include "6502/batch.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/InstructionSet/arithmetic.h"
+
+namespace {
+// Flag positions inside the status register.
+constexpr uint8_t FLAG_C = 1 << 0;
+constexpr uint8_t FLAG_Z = 1 << 1;
+constexpr uint8_t FLAG_D = 1 << 3;
+constexpr uint8_t FLAG_V = 1 << 6;
+constexpr uint8_t FLAG_N = 1 << 7;
+
+constexpr uint8_t IO_PAGE = Regions::IO.begin >> 8;
+constexpr uint8_t STACK_PAGE = Regions::STACK.begin >> 8;
+
+/// \p sr with N and Z set from \p v.
+inline uint8_t with_nz(uint8_t sr, uint8_t v) {
+  return (sr & ~(FLAG_N | FLAG_Z)) | (v & FLAG_N) | (v == 0 ? FLAG_Z : 0);
+}
+
+/// Whether a scalar step starting with \p desc may write memory outside the
+/// stack. A single step runs no loop idioms or superinstructions, so it is
+/// down to the instruction itself.
+bool may_write(const InstDesc& desc) {
+  switch (desc.mon) {
+    case Mnemonic::STA:
+    case Mnemonic::STX:
+    case Mnemonic::STY:
+    // Undocumented opcodes, which the scalar step runs on NMOS.
+    case Mnemonic::INVALID:
+      return true;
+    case Mnemonic::INC:
+    case Mnemonic::DEC:
+    case Mnemonic::ASL:
+    case Mnemonic::LSR:
+    case Mnemonic::ROL:
+    case Mnemonic::ROR:
+      return desc.mode != AdrMode::A;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+
+BatchProcessor::BatchProcessor(const std::vector<uint8_t>& image,
+                               size_t count)
+    : lanes(count), image(image), bucket_at(ADDR_SPACE_SZ, NO_BUCKET) {
+  for (size_t i = 0; i < count; i++) {
+    mem.emplace_back(this->image);
+    assert(mem.back().data() && "couldn't map the lane's memory");
+    scalar.push_back(std::make_unique<Processor>(mem.back().data()));
+    const Processor& p = *scalar.back();
+    lanes[i] = {mem.back().data(), p.cycles, 0, p.PC, p.AC, p.X, p.Y, p.SR,
+                p.SP, false, false};
+  }
+  group.reserve(count);
+}
+
+std::vector<uint32_t>& BatchProcessor::bucket(word_t pc) {
+  uint32_t& b = bucket_at[pc];
+  if (b == NO_BUCKET) {
+    if (free_buckets.empty()) {
+      b = buckets.size();
+      buckets.emplace_back();
+    } else {
+      b = free_buckets.back();
+      free_buckets.pop_back();
+    }
+    occupied[pc / 64] |= 1ull << pc % 64;
+    occupied_words[pc / 4096] |= 1ull << pc / 64 % 64;
+  }
+  return buckets[b];
+}
+
+void BatchProcessor::enqueue(uint32_t i) {
+  const Lane& l = lanes[i];
+  if (!l.idle()) bucket(l.PC).push_back(i);
+}
+
+void BatchProcessor::move_to(word_t pc, std::vector<uint32_t>& ids,
+                             bool any_idle) {
+  if (any_idle) {
+    size_t kept = 0;
+    for (uint32_t i : ids) {
+      // The lane's PC has to be current once it is out of the buckets.
+      lanes[i].PC = pc;
+      if (!lanes[i].idle()) ids[kept++] = i;
+    }
+    ids.resize(kept);
+  }
+  if (ids.empty()) return;
+  std::vector<uint32_t>& to = bucket(pc);
+  if (to.empty()) {
+    // The usual case: the whole group moves on, with no copying.
+    to.swap(ids);
+  } else {
+    to.insert(to.end(), ids.begin(), ids.end());
+  }
+  ids.clear();
+}
+
+uint32_t BatchProcessor::take_lowest() {
+  size_t w = 0;
+  while (w < occupied_words.size() && !occupied_words[w]) w++;
+  if (w == occupied_words.size()) return UINT32_MAX;
+  size_t word = w * 64 + std::countr_zero(occupied_words[w]);
+  uint32_t pc = word * 64 + std::countr_zero(occupied[word]);
+
+  uint32_t b = std::exchange(bucket_at[pc], NO_BUCKET);
+  group.clear();
+  group.swap(buckets[b]);
+  free_buckets.push_back(b);
+  occupied[word] &= ~(1ull << pc % 64);
+  if (!occupied[word]) occupied_words[w] &= ~(1ull << word % 64);
+  return pc;
+}
+
+void BatchProcessor::diff_page(uint8_t page) {
+  compared_pages[page] = 1;
+  const uint8_t* first = mem[0].data() + page * PAGE_SZ;
+  for (size_t i = 1; i < mem.size() && !written_pages[page]; i++) {
+    written_pages[page] =
+        std::memcmp(first, mem[i].data() + page * PAGE_SZ, PAGE_SZ) != 0;
+  }
+}
+
+void BatchProcessor::step_scalar(size_t i) {
+  Lane& l = lanes[i];
+  Processor& p = *scalar[i];
+  // Pushes only ever touch the stack page.
+  written_pages[STACK_PAGE] = 1;
+  if (!l.unsure && may_write(decode_desc(l.base[l.PC]))) {
+    l.unsure = true;
+    unsure_lanes++;
+  }
+
+  p.PC = l.PC;
+  p.AC = l.AC;
+  p.X = l.X;
+  p.Y = l.Y;
+  *reinterpret_cast<uint8_t*>(&p.SR) = l.SR;
+  p.SP = l.SP;
+  p.cycles = l.cycles;
+  if (!p.step()) l.done = true;
+  l.PC = p.PC;
+  l.AC = p.AC;
+  l.X = p.X;
+  l.Y = p.Y;
+  l.SR = p.SR;
+  l.SP = p.SP;
+  l.cycles = p.cycles;
+  --l.steps_left;
+  ++scalar_steps;
+}
+
+void BatchProcessor::run(uint64_t max_steps) {
+  if (host_touched) {
+    compared_pages.fill(0);
+    host_touched = false;
+  }
+  for (uint32_t start = 0; start < lanes.size(); start += CHUNK) {
+    uint32_t end = std::min<size_t>(start + CHUNK, lanes.size());
+    for (uint32_t i = start; i < end; i++) {
+      lanes[i].steps_left = max_steps;
+      enqueue(i);
+    }
+    run_queued();
+  }
+}
+
+void BatchProcessor::run_queued() {
+  uint32_t leader;
+  while ((leader = take_lowest()) != UINT32_MAX) {
+    const uint8_t* ref_mem = lanes[group[0]].base;
+    uint8_t code[3];
+    for (int k = 0; k < 3; k++) code[k] = ref_mem[(word_t)(leader + k)];
+    InstDesc desc = decode_desc(code[0]);
+
+    // Lanes which rewrote their code at this address can't join the group.
+    uint8_t first_page = leader >> 8;
+    uint8_t last_page = (word_t)(leader + desc.sz - 1) >> 8;
+    if (!compared_pages[first_page]) diff_page(first_page);
+    if (!compared_pages[last_page]) diff_page(last_page);
+    bool check_all = written_pages[first_page] || written_pages[last_page] ||
+                     lanes[group[0]].unsure;
+    if (check_all || unsure_lanes) {
+      size_t kept = 1;
+      for (size_t g = 1; g < group.size(); g++) {
+        uint32_t i = group[g];
+        Lane& l = lanes[i];
+        bool same = true;
+        if (check_all || l.unsure) {
+          for (int k = 0; k < desc.sz; k++) {
+            same &= l.base[(word_t)(leader + k)] == code[k];
+          }
+        }
+        if (same) {
+          group[kept++] = i;
+        } else {
+          l.PC = leader;
+          step_scalar(i);
+          enqueue(i);
+        }
+      }
+      group.resize(kept);
+    }
+
+    size_t count = group.size();
+    if (step_group(desc, leader, code)) {
+      vector_steps += count;
+      continue;
+    }
+    for (uint32_t i : group) {
+      lanes[i].PC = leader;
+      step_scalar(i);
+      enqueue(i);
+    }
+  }
+}
+
+bool BatchProcessor::step_group(const InstDesc& desc, word_t pc,
+                                const uint8_t* code) {
+  // Everything the lane loops need, in locals, so that the stores to lane
+  // memory don't make the compiler reload them.
+  const AdrMode mode = desc.mode;
+  const uint8_t imm = code[1];
+  const word_t abs = code[1] | code[2] << 8;
+  const word_t next = pc + desc.sz;
+  const uint8_t cycles = desc.cycles;
+  const bool page_penalty = desc.page_penalty;
+
+  // Effective address, mirroring the interpreter's address modes.
+  auto address = [=](const Lane& l) -> word_t {
+    switch (mode) {
+      case AdrMode::ZPG:
+        return imm;
+      case AdrMode::ZP_X:
+        return imm + l.X;
+      case AdrMode::ZP_Y:
+        return imm + l.Y;
+      case AdrMode::ABS_X:
+        return abs + l.X;
+      case AdrMode::ABS_Y:
+        return abs + l.Y;
+      default:
+        return abs;
+    }
+  };
+  switch (mode) {
+    case AdrMode::IMP:
+    case AdrMode::A:
+    case AdrMode::IMM:
+    case AdrMode::REL:
+    case AdrMode::ZPG:
+    case AdrMode::ZP_X:
+    case AdrMode::ZP_Y:
+    case AdrMode::ABS:
+    case AdrMode::ABS_X:
+    case AdrMode::ABS_Y:
+      break;
+    default:
+      // Indirect modes go through the scalar path.
+      return false;
+  }
+
+  // Stores to device registers have to be seen by the device.
+  bool writes = desc.mon == Mnemonic::STA || desc.mon == Mnemonic::STX ||
+                desc.mon == Mnemonic::STY || desc.mon == Mnemonic::INC ||
+                desc.mon == Mnemonic::DEC;
+  if (writes) {
+    for (uint32_t i : group) {
+      if (address(lanes[i]) >> 8 == IO_PAGE) return false;
+    }
+  }
+
+  // Run \p fn on every lane of the group and retire the instruction, moving
+  // the group on to \p to.
+  auto each_to = [&](word_t to, auto fn) {
+    bool any_idle = false;
+    for (uint32_t i : group) {
+      Lane& l = lanes[i];
+      fn(l);
+      l.cycles += cycles;
+      any_idle |= --l.steps_left == 0;
+    }
+    move_to(to, group, any_idle);
+  };
+  auto each = [&](auto fn) { each_to(next, fn); };
+  auto operand = [=](Lane& l) -> uint8_t {
+    if (mode == AdrMode::IMM) return imm;
+    word_t addr = address(l);
+    // Only the absolute indexed modes get here with a page penalty.
+    if (page_penalty) l.cycles += Processor::crosses_page(abs, addr);
+    return l.base[addr];
+  };
+  auto store = [&](Lane& l, uint8_t v) {
+    word_t addr = address(l);
+    written_pages[addr >> 8] = 1;
+    l.base[addr] = v;
+  };
+  auto modify = [&](int8_t delta) {
+    each([&](Lane& l) {
+      uint8_t v = operand(l) + delta;
+      l.SR = with_nz(l.SR, v);
+      store(l, v);
+    });
+  };
+  auto compare = [&](uint8_t Lane::*reg) {
+    each([&](Lane& l) {
+      uint8_t r = l.*reg;
+      uint8_t v = operand(l);
+      uint8_t sr = with_nz(l.SR, r - v);
+      l.SR = (sr & ~FLAG_C) | (r >= v ? FLAG_C : 0);
+    });
+  };
+  auto arith = [&](const ArithTables::Table& table) {
+    each([&](Lane& l) {
+      uint8_t sr = l.SR;
+      uint16_t entry = table[ArithTables::index(sr & FLAG_D, sr & FLAG_C,
+                                                l.AC, operand(l))];
+      l.AC = entry & 0xFF;
+      l.SR = (sr & ~ArithTables::FLAGS_MASK) | entry >> 8;
+    });
+  };
+  auto flag = [&](uint8_t bit, bool set) {
+    each([&](Lane& l) { l.SR = set ? l.SR | bit : l.SR & ~bit; });
+  };
+  auto branch = [&](uint8_t bit, bool want) {
+    word_t target = next + (int8_t)imm;
+    uint8_t taken_cost = 1 + Processor::crosses_page(next, target);
+    uint8_t flip = want ? 0 : bit;
+    // Lanes which fall through stay in the group, the others go to taken.
+    bool any_idle = false;
+    size_t kept = 0;
+    for (uint32_t i : group) {
+      Lane& l = lanes[i];
+      bool jump = (l.SR ^ flip) & bit;
+      l.cycles += cycles + jump * taken_cost;
+      any_idle |= --l.steps_left == 0;
+      if (jump) {
+        taken.push_back(i);
+      } else {
+        group[kept++] = i;
+      }
+    }
+    group.resize(kept);
+    move_to(next, group, any_idle);
+    move_to(target, taken, any_idle);
+  };
+
+  switch (desc.mon) {
+    case Mnemonic::LDA:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC = operand(l)); });
+      break;
+    case Mnemonic::LDX:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.X = operand(l)); });
+      break;
+    case Mnemonic::LDY:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.Y = operand(l)); });
+      break;
+    case Mnemonic::STA:
+      each([&](Lane& l) { store(l, l.AC); });
+      break;
+    case Mnemonic::STX:
+      each([&](Lane& l) { store(l, l.X); });
+      break;
+    case Mnemonic::STY:
+      each([&](Lane& l) { store(l, l.Y); });
+      break;
+    case Mnemonic::TAX:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.X = l.AC); });
+      break;
+    case Mnemonic::TAY:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.Y = l.AC); });
+      break;
+    case Mnemonic::TXA:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC = l.X); });
+      break;
+    case Mnemonic::TYA:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC = l.Y); });
+      break;
+    case Mnemonic::INX:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, ++l.X); });
+      break;
+    case Mnemonic::INY:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, ++l.Y); });
+      break;
+    // The interpreter leaves the flags alone on DEX and DEY.
+    case Mnemonic::DEX:
+      each([&](Lane& l) { --l.X; });
+      break;
+    case Mnemonic::DEY:
+      each([&](Lane& l) { --l.Y; });
+      break;
+    case Mnemonic::INC:
+      modify(1);
+      break;
+    case Mnemonic::DEC:
+      modify(-1);
+      break;
+    case Mnemonic::CMP:
+      compare(&Lane::AC);
+      break;
+    case Mnemonic::CPX:
+      compare(&Lane::X);
+      break;
+    case Mnemonic::CPY:
+      compare(&Lane::Y);
+      break;
+    case Mnemonic::AND:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC &= operand(l)); });
+      break;
+    case Mnemonic::EOR:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC ^= operand(l)); });
+      break;
+    case Mnemonic::ORA:
+      each([&](Lane& l) { l.SR = with_nz(l.SR, l.AC |= operand(l)); });
+      break;
+    case Mnemonic::ADC:
+      arith(ArithTables::ADC);
+      break;
+    case Mnemonic::SBC:
+      arith(ArithTables::SBC);
+      break;
+    case Mnemonic::CLC:
+      flag(FLAG_C, false);
+      break;
+    case Mnemonic::SEC:
+      flag(FLAG_C, true);
+      break;
+    case Mnemonic::CLD:
+      flag(FLAG_D, false);
+      break;
+    case Mnemonic::SED:
+      flag(FLAG_D, true);
+      break;
+    case Mnemonic::CLV:
+      flag(FLAG_V, false);
+      break;
+    case Mnemonic::BCC:
+      branch(FLAG_C, false);
+      break;
+    case Mnemonic::BCS:
+      branch(FLAG_C, true);
+      break;
+    case Mnemonic::BNE:
+      branch(FLAG_Z, false);
+      break;
+    case Mnemonic::BEQ:
+      branch(FLAG_Z, true);
+      break;
+    case Mnemonic::BPL:
+      branch(FLAG_N, false);
+      break;
+    case Mnemonic::BMI:
+      branch(FLAG_N, true);
+      break;
+    case Mnemonic::BVC:
+      branch(FLAG_V, false);
+      break;
+    case Mnemonic::BVS:
+      branch(FLAG_V, true);
+      break;
+    case Mnemonic::JMP:
+      if (mode != AdrMode::ABS) return false;
+      each_to(abs, [](Lane&) {});
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,44 @@
+#include "6502/heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Render/png.h"
+
+namespace {
+/// Brightness of \p count on a log scale where \p max is full brightness.
+uint32_t level(uint32_t count, float log_max) {
+  if (!count) return 0;
+  // Anything touched at all stays visible.
+  return 48.5f + 207 * std::log((float)count) / log_max;
+}
+
+float log_max(const std::array<uint32_t, ADDR_SPACE_SZ>& counters) {
+  uint32_t max = *std::max_element(counters.begin(), counters.end());
+  // log(1) is 0; keep single accesses from dividing by it.
+  return std::log((float)std::max<uint32_t>(max, 2));
+}
+}  // namespace
+
+void AccessHeatmap::clear() {
+  reads.fill(0);
+  writes.fill(0);
+  execs.fill(0);
+}
+
+void AccessHeatmap::to_rgba(uint32_t* rgba) const {
+  float r_max = log_max(writes);
+  float g_max = log_max(reads);
+  float b_max = log_max(execs);
+  for (size_t addr = 0; addr < ADDR_SPACE_SZ; addr++) {
+    rgba[addr] = level(writes[addr], r_max) | level(reads[addr], g_max) << 8 |
+                 level(execs[addr], b_max) << 16 | 0xFF000000;
+  }
+}
+
+bool AccessHeatmap::save_png(const std::string& path) const {
+  std::vector<uint32_t> rgba(SIDE * SIDE);
+  to_rgba(rgba.data());
+  return write_png(path, rgba.data(), SIDE, SIDE);
+}
@@ -1,32 +1,539 @@
 #include "6502/processor.h"
 
-#include <bitset>
+#include <algorithm>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <ostream>
 
 #include "6502/InstructionSet/address_space.h"
+#include "6502/InstructionSet/arithmetic.h"
+#include "6502/profiler.h"
+#include "Devices/blitter.h"
+#include "Devices/interrupts.h"
+#include "Devices/mathunit.h"
+#include "Replay/inputlog.h"
+#include "Replay/timeline.h"
 
-void Processor::check_for_interrupts() {
-  if (reset) {
-    memcpy(RAM.data(), reset, ADDR_SPACE_SZ);
-    reset_internal_state();
-    reset = nullptr;
+void Processor::post(HostEvent event) {
+  std::lock_guard<std::mutex> guard(host_lock);
+  host_events.push_back(std::move(event));
+  host_events_pending.store(true, std::memory_order_release);
+  host_wake.notify_one();
+}
+
+bool Processor::apply_host_events() {
+  std::vector<HostEvent> events;
+  {
+    std::lock_guard<std::mutex> guard(host_lock);
+    events.swap(host_events);
+    host_events_pending.store(false, std::memory_order_relaxed);
+  }
+  for (const HostEvent &event : events) {
+    if (recorder) recorder->append(cycles, event);
+    switch (event.kind) {
+      case HostEvent::Kind::IO_WRITE:
+        write(event.addr, event.value);
+        break;
+      case HostEvent::Kind::RELOAD:
+        // Copy only the pages that changed so that untouched pages of a
+        // shared image stay shared.
+        for (size_t page = 0; page < ADDR_SPACE_SZ; page += PAGE_SZ) {
+          const uint8_t *src = event.image->data() + page;
+          if (memcmp(RAM + page, src, PAGE_SZ)) {
+            memcpy(RAM + page, src, PAGE_SZ);
+            mark_dirty(page, PAGE_SZ);
+          }
+        }
+        if (audio_out) audio.render(cycles, *audio_out);
+        audio.latch(RAM);
+        reset_internal_state();
+        ++reloads;
+        break;
+      case HostEvent::Kind::STOP:
+        return false;
+      case HostEvent::Kind::VSYNC:
+        if (waiting && !timer_ends_wait()) {
+          cycles = std::max(cycles, frame_start + FRAME_CYCLES);
+        }
+        frame_start = cycles;
+        ++RAM[IO::frame];
+        ++vsyncs;
+        if (timeline) timeline->append(*this);
+        raise_irq(IRQ_VSYNC);
+        break;
+    }
+  }
+  return true;
+}
+
+void Processor::timeline_to(TimelineRecorder *tl) {
+  timeline = tl;
+  if (timeline) timeline->append(*this);
+}
+
+void Processor::io_write(word_t addr, uint8_t data) {
+  if (addr >= IO::audio_square0_period &&
+      addr < IO::audio_square0_period + AudioUnit::NUM_REGS) {
+    // Finish the sound of the old values up to this cycle.
+    if (audio_out) audio.render(cycles, *audio_out);
+    audio.latch(RAM);
+    return;
+  }
+  if (addr >= IO::console_char && addr < IO::console_char + Console::NUM_REGS) {
+    if (console.write(addr, data)) {
+      scheduler.schedule(DeviceEvent::CONSOLE, cycles + Console::FLUSH_CYCLES);
+    }
+    return;
+  }
+  switch (addr) {
+    case IO::blit_cmd:
+      // Devices stall the CPU for as long as they run.
+      mark_dirty(Blitter::destination(RAM), Blitter::extent(RAM));
+      cycles += Blitter::run(RAM, data);
+      break;
+    case IO::math_op:
+      cycles += MathUnit::run(RAM, data);
+      break;
+    case IO::timer_ctrl: {
+      word_t period = read_word(IO::timer_period);
+      if (data & TIMER_RUN) {
+        scheduler.schedule(DeviceEvent::TIMER,
+                           cycles + (period ? period : 0x10000));
+      } else {
+        scheduler.cancel(DeviceEvent::TIMER);
+      }
+      break;
+    }
+    case IO::irq_enable:
+      irq_mask = data;
+      raise_irq(0);
+      break;
+    case IO::irq_status:
+      irq_pending &= ~data;
+      raise_irq(0);
+      break;
+    case IO::wait:
+      wait_mask = data ? data : 0xFF;
+      waiting = true;
+      break;
+  }
+}
+
+void Processor::raise_irq(uint8_t sources) {
+  irq_pending |= sources;
+  RAM[IO::irq_status] = irq_pending;
+  irq_line = irq_pending & irq_mask;
+}
+
+void Processor::enter_irq() {
+  push(PC >> 8);
+  push(PC & 0xFF);
+  StatusRegister to_push = SR;
+  to_push.B = 0;
+  to_push._ = 1;
+  push(to_push);
+  SR.I = 1;
+  PC = read_word(IRQ_VECTOR);
+  cycles += IRQ_CYCLES;
+  if (profiler) profiler->enter(PC, SP, cycles);
+  // Taking an interrupt ends a wait, like WAI on the 65C02.
+  waiting = false;
+}
+
+void Processor::run_devices() {
+  DeviceEvent event;
+  uint64_t due;
+  while (scheduler.pop_due(cycles, event, due)) {
+    switch (event) {
+      case DeviceEvent::TIMER:
+        run_timer(due);
+        break;
+      case DeviceEvent::AUDIO:
+        run_audio();
+        break;
+      case DeviceEvent::CONSOLE:
+        console.hand_off();
+        break;
+      case DeviceEvent::NUM_EVENTS:
+        break;
+    }
+  }
+}
+
+void Processor::run_timer(uint64_t due) {
+  word_t period = read_word(IO::timer_period);
+  uint64_t next = due + (period ? period : 0x10000);
+  // Don't fire a burst of ticks to catch up after a long stall.
+  scheduler.schedule(DeviceEvent::TIMER, std::max(next, cycles + 1));
+  raise_irq(IRQ_TIMER);
+}
+
+void Processor::run_audio() {
+  audio.render(cycles, *audio_out);
+  schedule_audio();
+}
+
+bool Processor::idle(uint64_t until_cycle, bool block) {
+  if (irq_pending & wait_mask) {
+    waiting = false;
+    return true;
+  }
+  if (timer_ends_wait()) {
+    // Nobody can observe the cycles in between, so skip straight to the next
+    // device event, which may or may not be the timer.
+    cycles = std::max(cycles, std::min(scheduler.next(), until_cycle));
+    return true;
+  }
+  // Only the host can end this wait, which may take a while.
+  console.hand_off();
+  if (!block) return false;
+  wait_for_host();
+  return true;
+}
+
+bool Processor::timer_ends_wait() const {
+  bool timer_wakes =
+      (wait_mask & IRQ_TIMER) || ((irq_mask & IRQ_TIMER) && !SR.I);
+  return scheduler.deadline(DeviceEvent::TIMER) != UINT64_MAX && timer_wakes;
+}
+
+void Processor::wait_for_host() {
+  std::unique_lock<std::mutex> lock(host_lock);
+  host_wake.wait(lock, [this] {
+    return host_events_pending.load(std::memory_order_relaxed);
+  });
+}
+
+Fusion Processor::match_fusion() {
+  for (size_t i = 0; i < NUM_FUSIONS; i++) {
+    const FusionDesc &desc = FUSION_TABLE[i];
+    bool matches = true;
+    for (uint8_t j = 0; j < desc.len && matches; j++) {
+      matches = read(PC + desc.offsets[j]) == (uint8_t)desc.ops[j];
+    }
+    if (matches) return (Fusion)i;
+  }
+  return Fusion::NONE;
+}
+
+void Processor::run_fused(Fusion fused) {
+  const FusionDesc &desc = FUSION_TABLE[(size_t)fused];
+  ++fusion_hits[(size_t)fused];
+  cycles += desc.cycles;
+  retired += desc.len;
+  // The flags of the leading instructions are always overwritten by the
+  // compare or the store that follows, so only the final values are computed.
+  switch (fused) {
+    case Fusion::INX_CPX_BNE:
+    case Fusion::INY_CPY_BNE: {
+      uint8_t &reg = fused == Fusion::INX_CPX_BNE ? X : Y;
+      ++reg;
+      uint8_t imm = read(PC + desc.offsets[1] + 1);
+      uint8_t diff = reg - imm;
+      SR.N = diff & SIGN_BIT;
+      SR.Z = diff == 0;
+      SR.C = reg >= imm;
+      branch(!SR.Z, PC + desc.offsets[2]);
+      return;
+    }
+    case Fusion::CMP_BNE:
+    case Fusion::CMP_BEQ: {
+      uint8_t imm = read(PC + 1);
+      uint8_t diff = AC - imm;
+      SR.N = diff & SIGN_BIT;
+      SR.Z = diff == 0;
+      SR.C = AC >= imm;
+      branch(SR.Z == (fused == Fusion::CMP_BEQ), PC + desc.offsets[1]);
+      return;
+    }
+    case Fusion::LDA_IMM_STA_ZPG:
+      AC = read(PC + 1);
+      SR.N = AC & SIGN_BIT;
+      SR.Z = AC == 0;
+      write(read(PC + desc.offsets[1] + 1), AC);
+      break;
+    case Fusion::LDA_ZPG_STA_ABS_X:
+      AC = read(read(PC + 1));
+      SR.N = AC & SIGN_BIT;
+      SR.Z = AC == 0;
+      write(read_word(PC + desc.offsets[1] + 1) + X, AC);
+      break;
+    case Fusion::CLC_ADC:
+      apply_arith(ArithTables::ADC[ArithTables::index(
+          SR.D, false, AC, read(PC + desc.offsets[1] + 1))]);
+      break;
+    case Fusion::SEC_SBC:
+      apply_arith(ArithTables::SBC[ArithTables::index(
+          SR.D, true, AC, read(PC + desc.offsets[1] + 1))]);
+      break;
+    case Fusion::NONE:
+      assert(false && "no fusion to run");
+  }
+  PC += desc.sz;
+}
+
+namespace {
+/// Opcodes which can begin a fill or copy loop.
+constexpr bool is_loop_head(uint8_t byte) {
+  switch ((Opcode)byte) {
+    case Opcode::LDA_ABS_X:
+    case Opcode::LDA_ABS_Y:
+    case Opcode::STA_ABS_X:
+    case Opcode::STA_ABS_Y:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Opcodes at which the dispatcher looks further ahead for a loop idiom or a
+/// superinstruction.
+constexpr std::array<bool, 256> LOOKAHEAD_HEADS = [] {
+  std::array<bool, 256> heads = FUSION_HEADS;
+  for (int i = 0; i < 256; i++) heads[i] |= is_loop_head(i);
+  return heads;
+}();
+
+/// \return whether [a, a + a_len) and [b, b + b_len) share any address.
+bool overlaps(uint32_t a, uint32_t a_len, uint32_t b, uint32_t b_len) {
+  return a < b + b_len && b < a + a_len;
+}
+}  // namespace
+
+bool Processor::run_loop_idiom() {
+  // Recognized shape, with either X or Y as the index:
+  //   start: [LDA src,X]
+  //          STA dst,X
+  //          INX
+  //          [CPX #limit]
+  //          BNE start
+  word_t at = PC;
+  uint32_t per_iter = 0;
+  uint32_t insts = 0;
+  auto take = [&](Opcode op) {
+    if (read(at) != (uint8_t)op) return false;
+    InstDesc desc = decode_desc((uint8_t)op);
+    per_iter += desc.cycles;
+    ++insts;
+    at += desc.sz;
+    return true;
+  };
+
+  uint8_t head = read(PC);
+  bool use_y = head == (uint8_t)Opcode::LDA_ABS_Y ||
+               head == (uint8_t)Opcode::STA_ABS_Y;
+  bool copy = take(use_y ? Opcode::LDA_ABS_Y : Opcode::LDA_ABS_X);
+  word_t src = copy ? read_word(PC + 1) : 0;
+  word_t dst = read_word(at + 1);
+  if (!take(use_y ? Opcode::STA_ABS_Y : Opcode::STA_ABS_X)) return false;
+  if (!take(use_y ? Opcode::INY_IMP : Opcode::INX_IMP)) return false;
+  // Without a compare the loop runs until the index wraps to zero.
+  uint8_t limit = 0;
+  word_t cmp_at = at;
+  bool has_cmp = take(use_y ? Opcode::CPY_IMM : Opcode::CPX_IMM);
+  if (has_cmp) limit = read(cmp_at + 1);
+  word_t branch_at = at;
+  if (!take(Opcode::BNE_REL)) return false;
+  word_t end = at;
+  if ((word_t)(end + (int8_t)read(branch_at + 1)) != PC) return false;
+
+  uint8_t &index = use_y ? Y : X;
+  uint32_t first = index;
+  uint32_t count = (uint8_t)(limit - index);
+  if (count == 0) count = 256;
+  // The index would wrap back to the start of the table mid-loop.
+  if (first + count > 256) return false;
+
+  uint32_t dst_begin = dst + first;
+  uint32_t src_begin = src + first;
+  if (dst_begin + count > ADDR_SPACE_SZ) return false;
+  if (copy && src_begin + count > ADDR_SPACE_SZ) return false;
+  // Stores into the loop itself or into device registers must be observed one
+  // at a time, as must loads from device registers.
+  if (overlaps(dst_begin, count, PC, end - PC)) return false;
+  if (overlaps(dst_begin, count, Regions::IO.begin,
+               Regions::IO.num_pages * PAGE_SZ)) {
+    return false;
+  }
+  if (copy) {
+    if (overlaps(src_begin, count, Regions::IO.begin,
+                 Regions::IO.num_pages * PAGE_SZ)) {
+      return false;
+    }
+    // Copying forward onto a higher overlapping address replicates bytes,
+    // which memmove doesn't.
+    if (dst_begin > src_begin && overlaps(dst_begin, count, src_begin, count)) {
+      return false;
+    }
   }
+
+  cycles += per_iter * count;
+  retired += insts * count;
+  // Every branch but the last is taken.
+  cycles += (count - 1) * (1 + crosses_page(end, PC));
+#ifdef SFEM_COVERAGE
+  // As if branch() had run once per iteration, counters wrapping alike.
+  (*edges)[branch_at << 1 | 1] += count - 1;
+  ++(*edges)[branch_at << 1];
+#endif
+  if (copy) {
+    // The load takes an extra cycle for every index past the page boundary.
+    uint32_t lo = src & 0xFF;
+    uint32_t boundary = lo ? PAGE_SZ - lo : PAGE_SZ;
+    uint32_t from = std::max(first, boundary);
+    if (first + count > from) cycles += first + count - from;
+  }
+
+  if (copy) {
+    AC = read(src_begin + count - 1);
+    memmove(&RAM[dst_begin], &RAM[src_begin], count);
+    ++copy_loops;
+  } else {
+    memset(&RAM[dst_begin], AC, count);
+    ++fill_loops;
+  }
+  mark_dirty(dst_begin, count);
+  index = limit;
+  // The final INX or CPX saw the index reach the limit.
+  SR.N = 0;
+  SR.Z = 1;
+  if (has_cmp) SR.C = 1;
+  PC = end;
+  return true;
+}
+
+void Processor::print_dispatch_stats(std::ostream &os) const {
+  uint64_t total = 0;
+  for (uint64_t hits : fusion_hits) total += hits;
+  os << "Superinstruction hits (" << std::dec << total << " total)\n";
+  for (size_t i = 0; i < NUM_FUSIONS; i++) {
+    double share = total ? 100.0 * fusion_hits[i] / total : 0.0;
+    os << "  " << std::left << std::setw(20) << FUSION_TABLE[i].name
+       << std::right << std::setw(14) << fusion_hits[i] << std::setw(8)
+       << std::fixed << std::setprecision(2) << share << "%\n";
+  }
+  os << "Loop idioms\n";
+  os << "  " << std::left << std::setw(20) << "FILL" << std::right
+     << std::setw(14) << fill_loops << "\n";
+  os << "  " << std::left << std::setw(20) << "COPY" << std::right
+     << std::setw(14) << copy_loops << "\n";
 }
 
 uint8_t Processor::run() {
+  execute(UINT64_MAX, UINT64_MAX, true);
+  return AC;
+}
+
+std::optional<uint8_t> Processor::call(word_t addr, uint8_t a, uint8_t x,
+                                       uint8_t y) {
+  Registers saved = registers();
+  bool was_waiting = waiting;
+  uint8_t saved_return_SP = return_SP;
+
+  return_SP = SP;
+  PC = addr;
+  AC = a;
+  X = x;
+  Y = y;
+  waiting = false;
+  std::optional<uint8_t> result;
+  // Anything else stopped the routine short of its final RTS.
+  if (!execute(UINT64_MAX, UINT64_MAX, false) && SP == return_SP &&
+      RAM[PC] == (uint8_t)Opcode::RTS_IMP) {
+    result = AC;
+  }
+
+  set_registers(saved);
+  waiting = was_waiting;
+  return_SP = saved_return_SP;
+  return result;
+}
+
+bool Processor::execute(uint64_t steps, uint64_t until_cycle, bool block) {
+  bool watching = !watches.empty();
+  if (watching) hit.reset();
+  using enum CpuVariant;
+  bool running = false;
+  switch (variant) {
+    case NMOS:
+      running = watching ? interpret<NMOS, true>(steps, until_cycle, block)
+                         : interpret<NMOS, false>(steps, until_cycle, block);
+      break;
+    case CMOS:
+      running = watching ? interpret<CMOS, true>(steps, until_cycle, block)
+                         : interpret<CMOS, false>(steps, until_cycle, block);
+      break;
+  }
+  // Whoever drives us may not come back: sound ends here rather than at the
+  // last flush, and a guest which is done has its text written out too.
+  if (audio_out) audio.render(cycles, *audio_out);
+  if (!running) console.hand_off();
+  return running;
+}
+
+void Processor::flagged_write(word_t addr, uint8_t data) {
+  uint8_t flags = page_flags[addr >> 8];
+  if (flags & PAGE_TRACK) {
+    dirty[addr >> 8] = true;
+    page_flags[addr >> 8] &= ~PAGE_TRACK;
+  }
+  if (flags & WATCH_WRITE && watches.matches(addr, WATCH_WRITE)) {
+    watch_hit_at(WATCH_WRITE, addr);
+  }
+  if (flags & PAGE_IO) io_write(addr, data);
+}
+
+template <CpuVariant CPU, bool WATCH>
+bool Processor::interpret(uint64_t steps, uint64_t until_cycle,
+                          bool block) {
   // Used in operations that read from memory.
   word_t effective_address = 0;
   // This holds the result of a memory read.
   uint8_t memory = 0;
   // Used for random scratch storage space.
   uint8_t scratch = 0;
+  // A bounded step counts instructions exactly, so it runs without the loop
+  // idioms and superinstructions which retire several at once.
+  bool fast_paths = steps == UINT64_MAX;
 
-  while (true) {
-    check_for_interrupts();
+  while (steps-- && cycles < until_cycle) {
+    if (!check_for_interrupts()) return false;
+    if (waiting) {
+      // Still running, but nothing will happen until the host posts.
+      if (!idle(until_cycle, block)) return true;
+      // Time spent waiting isn't a step.
+      ++steps;
+      continue;
+    }
+    if constexpr (WATCH) {
+      if (page_flags[PC >> 8] & WATCH_EXEC && PC != resume_PC &&
+          watches.matches(PC, WATCH_EXEC)) {
+        watch_hit_at(WATCH_EXEC, PC);
+        watch_stop = false;
+        resume_PC = PC;
+        return false;
+      }
+      resume_PC = UINT32_MAX;
+    }
     uint8_t cur_byte = RAM[PC];
-    InstDesc idsc = decode_desc(cur_byte);
+#ifdef SFEM_HEATMAP
+    AccessHeatmap::count(heat->execs, PC);
+    constexpr bool COUNTING = true;
+#else
+    constexpr bool COUNTING = false;
+#endif
+    if (!WATCH && !COUNTING && fast_paths && LOOKAHEAD_HEADS[cur_byte]) {
+      if (run_loop_idiom()) continue;
+      Fusion fused = match_fusion();
+      if (fused != Fusion::NONE) {
+        run_fused(fused);
+        continue;
+      }
+    }
+    InstDesc idsc = VARIANT_TABLE<CPU>[cur_byte];
+    cycles += idsc.cycles;
+    ++retired;
     if (false) {
       std::cout << "PC: 0x" << std::hex << (PC - Regions::BOOTLOADER_ADDR)
                 << ", " << idsc << "\n";
@@ -41,35 +548,45 @@ uint8_t Processor::run() {
   SR.N = n & SIGN_BIT; \
   SR.Z = n == 0;
 
+      // Indexed reads take one more cycle when the index carries into the
+      // high byte of the address.
+#define PAGE_PENALTY(base, indexed) \
+  cycles += idsc.page_penalty && crosses_page(base, indexed);
+
       // Macros for reading memory for all address modes. They leave memory and
       // effective_address useful.
 #define READ_IMM memory = read(PC + 1);
 #define READ_ZPG                    \
   effective_address = read(PC + 1); \
-  memory = read(effective_address);
+  memory = load<WATCH>(effective_address);
 #define READ_ZP_X                       \
   effective_address = read(PC + 1) + X; \
-  memory = read(effective_address);
+  memory = load<WATCH>(effective_address);
 #define READ_ZP_Y                       \
   effective_address = read(PC + 1) + Y; \
-  memory = read(effective_address);
+  memory = load<WATCH>(effective_address);
 #define READ_ABS                         \
   effective_address = read_word(PC + 1); \
-  memory = read(effective_address);
-#define READ_ABS_X                           \
-  effective_address = read_word(PC + 1) + X; \
-  memory = read(effective_address);
-#define READ_ABS_Y                           \
-  effective_address = read_word(PC + 1) + Y; \
-  memory = read(effective_address);
+  memory = load<WATCH>(effective_address);
+#define READ_ABS_X                                        \
+  effective_address = read_word(PC + 1);                  \
+  PAGE_PENALTY(effective_address, effective_address + X); \
+  effective_address += X;                                 \
+  memory = load<WATCH>(effective_address);
+#define READ_ABS_Y                                        \
+  effective_address = read_word(PC + 1);                  \
+  PAGE_PENALTY(effective_address, effective_address + Y); \
+  effective_address += Y;                                 \
+  memory = load<WATCH>(effective_address);
 #define READ_X_IND                                  \
   effective_address = read(PC + 1) + X;             \
   effective_address = read_word(effective_address); \
-  memory = read(effective_address)
-#define READ_IND_Y                                  \
-  effective_address = read(PC + 1);                 \
-  effective_address = read_word(effective_address); \
-  memory = read(effective_address + Y);
+  memory = load<WATCH>(effective_address)
+#define READ_IND_Y                                        \
+  effective_address = read(PC + 1);                       \
+  effective_address = read_word(effective_address);       \
+  PAGE_PENALTY(effective_address, effective_address + Y); \
+  memory = load<WATCH>(effective_address + Y);
 
       // --- LDA
       case Opcode::LDA_IMM:
@@ -286,7 +803,7 @@ uint8_t Processor::run() {
       // --- PLP
       case Opcode::PLP_IMP: {
         StatusRegister old = SR;
-        SR = (StatusRegister)pop();
+        *reinterpret_cast<uint8_t *>(&SR) = pop();
         SR.B = old.B;
         SR._ = old._;
         BREAK_INC_PC;
@@ -365,13 +882,8 @@ uint8_t Processor::run() {
         BREAK_INC_PC;
 
         // --- ADC
-#define ADC(inp)                                            \
-  int8_t scratch = AC + inp + SR.C;                         \
-  SR.C = scratch < AC;                                      \
-  SR.Z = scratch == 0;                                      \
-  SR.N = scratch & SIGN_BIT;                                \
-  SR.V = (!((AC ^ inp) & 0x80) && ((AC ^ scratch) & 0x80)); \
-  AC = scratch;
+#define ADC(inp) \
+  apply_arith(ArithTables::ADC[ArithTables::index(SR.D, SR.C, AC, inp)]);
       case Opcode::ADC_IMM: {
         READ_IMM;
         ADC(memory);
@@ -414,14 +926,8 @@ uint8_t Processor::run() {
       }
 
       // --- SBC
-#define SBC(inp)                             \
-  int16_t scratch = AC - inp - (!SR.C);      \
-  SR.C = scratch >= 0;                       \
-  scratch &= 0xFF;                           \
-  SR.Z = scratch == 0;                       \
-  SR.N = scratch & SIGN_BIT;                 \
-  SR.V = (AC ^ scratch) & (AC ^ inp) & 0x80; \
-  AC = scratch & 0xFF;
+#define SBC(inp) \
+  apply_arith(ArithTables::SBC[ArithTables::index(SR.D, SR.C, AC, inp)]);
       case Opcode::SBC_IMM: {
         READ_IMM;
         SBC(memory);
@@ -633,7 +1139,7 @@ uint8_t Processor::run() {
         ROR_MEM;
       case Opcode::ROR_ABS_X:
         READ_ABS_X;
-        ROL_MEM;
+        ROR_MEM;
 
       // --- Clear instructions
       case Opcode::CLC_IMP:
@@ -654,7 +1160,6 @@ uint8_t Processor::run() {
         SR.C = 1;
         BREAK_INC_PC;
       case Opcode::SED_IMP:
-        assert(false && "Decimal mode unsupported.");
         SR.D = 1;
         BREAK_INC_PC;
       case Opcode::SEI_IMP:
@@ -727,13 +1232,9 @@ uint8_t Processor::run() {
         CMP(Y, memory);
         BREAK_INC_PC;
 
-#define BRANCH_IF(REG, test)    \
-  if (SR.REG == test) {         \
-    PC += (int8_t)read(PC + 1); \
-    PC += 2;                    \
-    break;                      \
-  }                             \
-  BREAK_INC_PC;
+#define BRANCH_IF(REG, test)  \
+  branch(SR.REG == test, PC); \
+  break;
       // --- BEQ
       case Opcode::BEQ_REL:
         BRANCH_IF(Z, 1);
@@ -777,12 +1278,14 @@ uint8_t Processor::run() {
         push(target_PC >> 8);
         push(target_PC & 0x00FF);
         PC = read_word(PC + 1);
+        if (profiler) profiler->enter(PC, SP, cycles);
         break;
       }
 
       // --- RTS
       case Opcode::RTS_IMP: {
-        if (SP == 0xFF) return AC;
+        if (SP == return_SP) return false;
+        if (profiler) profiler->leave(SP, cycles);
         PC = pop();
         PC |= static_cast<word_t>(pop()) << 8;
         // Make sure to add 1 to what we stored in the stack.
@@ -791,47 +1294,51 @@ uint8_t Processor::run() {
       }
 
       // --- RTI
+      // Returns to exactly the address pushed by enter_irq, with the flags as
+      // they were before the interrupt.
       case Opcode::RTI_IMP: {
-        StatusRegister pulled =
-            (StatusRegister)read(Regions::STACK.begin | SP + 1);
-        pulled.B = 0;
-        pulled._ = 0;
-        SR = (StatusRegister)(pulled | SR);
-        ++SP;
-        PC = read_word(Regions::STACK.begin | SP + 1) + 1;
-        SP += 2;
-        BREAK_INC_PC;
+        if (profiler) profiler->leave(SP, cycles);
+        StatusRegister old = SR;
+        *reinterpret_cast<uint8_t *>(&SR) = pop();
+        SR.B = old.B;
+        SR._ = old._;
+        PC = pop();
+        PC |= static_cast<word_t>(pop()) << 8;
+        break;
       }
 
       // --- BTT
       case Opcode::BIT_ZPG:
         READ_ZPG;
         SR.Z = (AC & memory) == 0;
-        SR.V = memory & (1 << 7);
-        SR.N = memory & (1 << 8);
+        SR.V = memory & 0x40;
+        SR.N = memory & SIGN_BIT;
         BREAK_INC_PC;
       case Opcode::BIT_ABS:
         READ_ABS;
         SR.Z = (AC & memory) == 0;
-        SR.V = memory & (1 << 7);
-        SR.N = memory & (1 << 8);
+        SR.V = memory & 0x40;
+        SR.N = memory & SIGN_BIT;
         BREAK_INC_PC;
 
       // --- NOP
-      case Opcode::NOP_IMP: {
-        std::cout << "NOP:AC=" << std::dec << +(uint8_t)AC << "/" << +(int8_t)AC
-                  << "\n";
-        uint8_t &sr = *reinterpret_cast<uint8_t *>(&SR);
-        std::cout << "    SR=" << std::bitset<8>(sr) << std::endl;
-        std::cout << "       " << "NV_BDIZC" << std::endl;
+      case Opcode::NOP_IMP:
         BREAK_INC_PC;
-      }
 
       default:
+        if constexpr (CPU == CpuVariant::NMOS) {
+          if (run_undocumented<WATCH>(idsc)) break;
+        } else {
+          if (run_65c02<WATCH>(idsc)) break;
+        }
         std::cerr << "PC: 0x" << std::hex << PC << ", unhandled " << idsc
                   << std::endl;
         assert(false && "unimplemnted op");
     }
+    if (WATCH && watch_stop) {
+      watch_stop = false;
+      return false;
+    }
   }
-  return 0;
+  return true;
 }
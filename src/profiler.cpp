@@ -0,0 +1,128 @@
+#include "6502/profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+constexpr uint32_t NO_PARENT = UINT32_MAX;
+}  // namespace
+
+CallProfiler::CallProfiler(word_t root, uint64_t now)
+    : last(now), routines(ADDR_SPACE_SZ), depth(ADDR_SPACE_SZ) {
+  nodes.push_back({root, NO_PARENT});
+  frames.push_back({0, root, 0x100, now});
+  ++routines[root].calls;
+  ++depth[root];
+}
+
+bool CallProfiler::load_labels(const std::string &path) {
+  std::ifstream input(path);
+  if (!input) return false;
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    std::string kind, addr, label;
+    if (!(fields >> kind >> addr >> label) || kind != "al") continue;
+    // ld65 prefixes labels with a dot.
+    if (label[0] == '.') label.erase(0, 1);
+    labels[std::stoul(addr, nullptr, 16)] = label;
+  }
+  return true;
+}
+
+std::string CallProfiler::name(word_t addr) const {
+  auto label = labels.find(addr);
+  if (label != labels.end()) return label->second;
+  std::ostringstream os;
+  os << '$' << std::hex << std::setw(4) << std::setfill('0') << addr;
+  return os.str();
+}
+
+void CallProfiler::charge(uint64_t now) {
+  const Frame &top = frames.back();
+  nodes[top.node].exclusive += now - last;
+  routines[top.addr].exclusive += now - last;
+  last = now;
+}
+
+void CallProfiler::pop(uint64_t now) {
+  const Frame &top = frames.back();
+  if (--depth[top.addr] == 0) routines[top.addr].inclusive += now - top.start;
+  frames.pop_back();
+}
+
+uint32_t CallProfiler::child(uint32_t parent, word_t addr) {
+  auto [it, added] =
+      children.try_emplace((uint64_t)parent << 16 | addr, nodes.size());
+  if (added) nodes.push_back({addr, parent});
+  return it->second;
+}
+
+void CallProfiler::enter(word_t addr, uint8_t sp, uint64_t now) {
+  if (frames.empty()) return;
+  charge(now);
+  // The new return address overwrote theirs.
+  while (frames.size() > 1 && frames.back().sp <= sp) pop(now);
+  frames.push_back({child(frames.back().node, addr), addr, sp, now});
+  ++routines[addr].calls;
+  ++depth[addr];
+}
+
+void CallProfiler::leave(uint8_t sp, uint64_t now) {
+  if (frames.empty()) return;
+  charge(now);
+  while (frames.size() > 1 && frames.back().sp < sp) pop(now);
+  if (frames.size() > 1 && frames.back().sp == sp) pop(now);
+}
+
+void CallProfiler::finish(uint64_t now) {
+  if (frames.empty()) return;
+  charge(now);
+  while (!frames.empty()) pop(now);
+}
+
+void CallProfiler::write_collapsed(std::ostream &os) const {
+  std::vector<std::string> path;
+  for (const Node &node : nodes) {
+    if (!node.exclusive) continue;
+    path.clear();
+    for (const Node *at = &node;; at = &nodes[at->parent]) {
+      path.push_back(name(at->addr));
+      if (at->parent == NO_PARENT) break;
+    }
+    for (size_t i = path.size(); i-- > 0;) {
+      os << path[i] << (i ? ";" : " ");
+    }
+    os << node.exclusive << "\n";
+  }
+}
+
+void CallProfiler::print_summary(std::ostream &os, size_t top) const {
+  std::vector<word_t> order;
+  uint64_t total = 0;
+  for (size_t addr = 0; addr < routines.size(); addr++) {
+    total += routines[addr].exclusive;
+    if (routines[addr].calls) order.push_back(addr);
+  }
+  std::sort(order.begin(), order.end(), [this](word_t a, word_t b) {
+    return routines[a].inclusive > routines[b].inclusive;
+  });
+  if (order.size() > top) order.resize(top);
+
+  os << "Routines by inclusive cycles (" << std::dec << total << " total)\n";
+  os << "  " << std::left << std::setw(20) << "routine" << std::right
+     << std::setw(10) << "calls" << std::setw(14) << "inclusive"
+     << std::setw(8) << "%" << std::setw(14) << "exclusive" << std::setw(8)
+     << "%" << "\n";
+  for (word_t addr : order) {
+    const RoutineStats &stats = routines[addr];
+    double incl = total ? 100.0 * stats.inclusive / total : 0.0;
+    double excl = total ? 100.0 * stats.exclusive / total : 0.0;
+    os << "  " << std::left << std::setw(20) << name(addr) << std::right
+       << std::setw(10) << stats.calls << std::setw(14) << stats.inclusive
+       << std::setw(8) << std::fixed << std::setprecision(2) << incl
+       << std::setw(14) << stats.exclusive << std::setw(8) << excl << "\n";
+  }
+}
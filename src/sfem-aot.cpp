@@ -0,0 +1,43 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+#include "Recompiler/runtime.h"
+#ifdef SFEM_FRONTEND
+#include "Render/window.h"
+#endif
+
+/// Entry point of a binary built with sfem_add_recompiled_rom(). The ROM is
+/// baked into the binary, so there is nothing to load or hot reload.
+int main() {
+  std::vector<uint8_t> memory(Recompiled::IMAGE,
+                              Recompiled::IMAGE + ADDR_SPACE_SZ);
+  Processor proc(memory);
+
+#ifdef SFEM_FRONTEND
+  std::thread renderer(draw_loop, std::ref(proc), nullptr);
+  Recompiled::run(proc);
+
+  renderer.join();
+#else
+  // Headless: a clock stands in for the window's frames, so that guests
+  // waiting for vsync still get them, and the guest returning ends the run.
+  std::atomic<bool> done = false;
+  std::thread ticker([&] {
+    using clock = std::chrono::steady_clock;
+    constexpr auto FRAME_TIME = std::chrono::microseconds(1000000 / 60);
+    for (auto next = clock::now() + FRAME_TIME; !done; next += FRAME_TIME) {
+      std::this_thread::sleep_until(next);
+      proc.post(HostEvent::vsync());
+    }
+  });
+  Recompiled::run(proc);
+
+  done = true;
+  ticker.join();
+#endif
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/batch.h"
+#include "6502/processor.h"
+
+namespace {
+/// Run when no ROM is given: a loop over the zero page whose branches depend
+/// on the lane's input byte at $10, so lanes split up and meet again.
+///
+///   LDX #0; LDA #0
+///   loop: CLC; ADC $10; EOR $11,X; TAY; CPY #77; BNE skip; INX
+///   skip: INX; CPX #200; BNE loop
+///   STA $20; RTS
+constexpr uint8_t DEFAULT_PROGRAM[] = {
+    0xA2, 0x00, 0xA9, 0x00, 0x18, 0x65, 0x10, 0x55, 0x11, 0xA8, 0xC0, 0x4D,
+    0xD0, 0x01, 0xE8, 0xE8, 0xE0, 0xC8, 0xD0, 0xF0, 0x85, 0x20, 0x60,
+};
+
+double millis(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void usage(const char *argv0) {
+  std::cerr << "usage: " << argv0 << " [<rom>] [options]\n"
+            << "Runs the ROM, or a built-in loop, on every lane of a batch\n"
+            << "and on as many scalar processors, and checks that each lane\n"
+            << "ends like its scalar processor.\n"
+            << "  --lanes <n>     lanes to run (1024)\n"
+            << "  --steps <n>     instructions each lane may run (10000000)\n"
+            << "  --input <addr>  byte set to a different value per lane, in\n"
+            << "                  hex (10)\n"
+            << "  --min-speedup <x>\n"
+            << "                  fail unless the batch runs at least <x>\n"
+            << "                  times as fast as the scalar processors"
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  const char *rom_path = nullptr;
+  size_t lanes = 1024;
+  uint64_t steps = 10000000;
+  word_t input = 0x10;
+  double min_speedup = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--lanes" && i + 1 < argc) {
+      lanes = std::stoull(argv[++i]);
+    } else if (arg == "--steps" && i + 1 < argc) {
+      steps = std::stoull(argv[++i]);
+    } else if (arg == "--input" && i + 1 < argc) {
+      input = std::stoul(argv[++i], nullptr, 16);
+    } else if (arg == "--min-speedup" && i + 1 < argc) {
+      min_speedup = std::stod(argv[++i]);
+    } else if (!rom_path && arg[0] != '-') {
+      rom_path = argv[i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!lanes) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<uint8_t> image(ADDR_SPACE_SZ, 0);
+  if (rom_path) {
+    std::ifstream rom(rom_path, std::ios::binary);
+    image.assign(std::istreambuf_iterator<char>(rom), {});
+    if (image.size() != ADDR_SPACE_SZ) {
+      std::cerr << rom_path << ": expected a " << ADDR_SPACE_SZ
+                << " byte image" << std::endl;
+      return 1;
+    }
+  } else {
+    std::copy(std::begin(DEFAULT_PROGRAM), std::end(DEFAULT_PROGRAM),
+              image.begin() + Regions::BOOTLOADER_ADDR);
+    for (word_t addr = 0x11; addr < 0x100; addr++) image[addr] = addr * 7;
+  }
+  auto lane_input = [](size_t lane) { return (uint8_t)(lane * 13 + 1); };
+
+  using clock = std::chrono::steady_clock;
+  BatchProcessor batch(image, lanes);
+  for (size_t lane = 0; lane < lanes; lane++) {
+    batch.memory(lane)[input] = lane_input(lane);
+  }
+  auto start = clock::now();
+  batch.run(steps);
+  clock::duration batch_time = clock::now() - start;
+
+  // step() counts single instructions, as the batch does, so both stop at
+  // the same point when the step budget runs out.
+  std::vector<std::vector<uint8_t>> memories(lanes, image);
+  std::vector<std::unique_ptr<Processor>> procs;
+  auto make_procs = [&] {
+    procs.clear();
+    for (size_t lane = 0; lane < lanes; lane++) {
+      memories[lane] = image;
+      memories[lane][input] = lane_input(lane);
+      procs.push_back(std::make_unique<Processor>(memories[lane]));
+      procs.back()->console_to(-1);
+    }
+  };
+  make_procs();
+  std::vector<bool> running(lanes);
+  start = clock::now();
+  for (size_t lane = 0; lane < lanes; lane++) {
+    running[lane] = procs[lane]->step(steps);
+  }
+  clock::duration step_time = clock::now() - start;
+
+  size_t mismatches = 0;
+  for (size_t lane = 0; lane < lanes; lane++) {
+    const Processor &proc = *procs[lane];
+    const char *what = nullptr;
+    if (batch.halted(lane) == running[lane]) {
+      what = "halted";
+    } else if (batch.accumulator(lane) != proc.registers().AC) {
+      what = "accumulator";
+    } else if (batch.cycle_count(lane) != proc.cycle_count()) {
+      what = "cycles";
+    } else if (memcmp(batch.memory(lane), proc.memory(), ADDR_SPACE_SZ)) {
+      what = "memory";
+    }
+    if (!what) continue;
+    // The first few tell the story; the count tells the rest.
+    if (++mismatches <= 8) {
+      std::cerr << "lane " << lane << ": " << what << " differs" << std::endl;
+    }
+  }
+
+  // step(n) leaves out the interpreter's loop idioms and superinstructions,
+  // so the batch is measured against run(), as the scalar processor is
+  // normally used. That only stops where the batch did if every lane
+  // returned within the step budget.
+  bool all_halted = std::find(running.begin(), running.end(), true) ==
+                    running.end();
+  clock::duration scalar_time = step_time;
+  if (all_halted) {
+    make_procs();
+    start = clock::now();
+    for (auto &proc : procs) proc->run();
+    scalar_time = clock::now() - start;
+  }
+  double speedup = millis(scalar_time) / millis(batch_time);
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "lanes:           " << lanes << "\n"
+            << "lockstep steps:  " << batch.lockstep_steps() << "\n"
+            << "fallback steps:  " << batch.fallback_steps() << "\n"
+            << "batch:           " << millis(batch_time) << " ms\n"
+            << "scalar step(n):  " << millis(step_time) << " ms\n";
+  if (all_halted) {
+    std::cout << "scalar run():    " << millis(scalar_time) << " ms\n";
+  } else {
+    std::cout << "scalar run():    skipped, lanes still running\n";
+  }
+  std::cout << "speedup:         " << std::setprecision(2) << speedup << "x\n"
+            << "mismatches:      " << mismatches << std::endl;
+  if (speedup < min_speedup) {
+    std::cerr << "speedup below the required " << min_speedup << "x"
+              << std::endl;
+    return 1;
+  }
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <array>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+#include "6502/snapshot.h"
+
+namespace {
+/// Bytes of one page which take part of the input, from \c first to \c last.
+struct InputRange {
+  word_t page;
+  uint8_t first;
+  uint8_t last;
+  uint32_t size() const { return last - first + 1; }
+};
+
+/// Parse "<first>-<last>" in hex, offsets within \p page.
+bool parse_range(const std::string &arg, word_t page, InputRange &range) {
+  size_t dash = arg.find('-');
+  if (dash == std::string::npos) return false;
+  unsigned long first = std::stoul(arg.substr(0, dash), nullptr, 16);
+  unsigned long last = std::stoul(arg.substr(dash + 1), nullptr, 16);
+  if (first > last || last > 0xFF) return false;
+  range = {page, (uint8_t)first, (uint8_t)last};
+  return true;
+}
+
+/// Hit counts folded into power of two buckets, one bit each, so that a loop
+/// running a few more times isn't new coverage but running twice as often is.
+constexpr std::array<uint8_t, 256> BUCKETS = [] {
+  std::array<uint8_t, 256> buckets{};
+  for (int n = 1; n < 256; n++) {
+    buckets[n] = n == 1    ? 1
+                 : n == 2  ? 2
+                 : n == 3  ? 4
+                 : n < 8   ? 8
+                 : n < 16  ? 16
+                 : n < 32  ? 32
+                 : n < 128 ? 64
+                           : 128;
+  }
+  return buckets;
+}();
+
+/// Entries of the coverage map which can be hit: the two outcomes of every
+/// address holding a branch opcode in \p image. Code the guest writes at run
+/// time isn't covered.
+std::vector<uint32_t> branch_slots(const std::vector<uint8_t> &image,
+                                   CpuVariant variant) {
+  std::vector<uint32_t> slots;
+  for (uint32_t addr = 0; addr < image.size(); addr++) {
+    if (variant_byte_to_inst(image[addr], variant).mode != AdrMode::REL) {
+      continue;
+    }
+    slots.push_back(addr << 1);
+    slots.push_back(addr << 1 | 1);
+  }
+  return slots;
+}
+
+/// Fold the coverage of the last run into \p seen and clear it. \return
+/// whether it hit a branch outcome, or a bucket of one, not seen before.
+bool merge_coverage(BranchCoverage &coverage, BranchCoverage &seen,
+                    const std::vector<uint32_t> &slots) {
+  bool novel = false;
+  // Only visit the entries which can be set, as clearing the whole map
+  // would take longer than most runs.
+  for (uint32_t slot : slots) {
+    if (!coverage[slot]) continue;
+    uint8_t bucket = BUCKETS[coverage[slot]];
+    if (bucket & ~seen[slot]) {
+      seen[slot] |= bucket;
+      novel = true;
+    }
+    coverage[slot] = 0;
+  }
+  return novel;
+}
+
+size_t count_edges(const BranchCoverage &seen) {
+  size_t edges = 0;
+  for (uint8_t buckets : seen) edges += buckets != 0;
+  return edges;
+}
+
+/// Stack a few random edits onto \p input.
+void mutate(std::vector<uint8_t> &input,
+            const std::vector<std::vector<uint8_t>> &corpus,
+            std::mt19937_64 &rng) {
+  static constexpr uint8_t INTERESTING[] = {0x00, 0x01, 0x7F, 0x80, 0xFF};
+  int edits = 1 + rng() % 4;
+  for (int i = 0; i < edits; i++) {
+    uint8_t &byte = input[rng() % input.size()];
+    switch (rng() % 5) {
+      case 0:
+        byte ^= 1 << (rng() % 8);
+        break;
+      case 1:
+        byte = rng();
+        break;
+      case 2:
+        byte = INTERESTING[rng() % std::size(INTERESTING)];
+        break;
+      case 3:
+        byte += (rng() % 2 ? 1 : -1) * (int)(1 + rng() % 16);
+        break;
+      case 4: {
+        // Splice in a run of bytes from another input.
+        const std::vector<uint8_t> &other = corpus[rng() % corpus.size()];
+        size_t at = rng() % input.size();
+        size_t len = 1 + rng() % (input.size() - at);
+        std::copy(other.begin() + at, other.begin() + at + len,
+                  input.begin() + at);
+        break;
+      }
+    }
+  }
+}
+
+void save(const std::string &path, const std::vector<uint8_t> &input) {
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(input.data()), input.size());
+}
+
+/// The input being run and where to save it if the guest makes the emulator
+/// abort, e.g. on an opcode it doesn't implement.
+const std::vector<uint8_t> *current_input = nullptr;
+char crash_path[4096];
+
+void on_abort(int) {
+  int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    ssize_t written = write(fd, current_input->data(), current_input->size());
+    (void)written;
+    close(fd);
+  }
+  static const char msg[] = "sfem-fuzz: emulator aborted, input saved\n";
+  ssize_t written = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+  (void)written;
+  _exit(1);
+}
+
+void usage(const char *argv0) {
+  std::cerr << "usage: " << argv0 << " <rom> <entry> [options]\n"
+            << "Calls the routine at <entry>, in hex, from the state of the\n"
+            << "image as loaded, with inputs in the zero page and IO page.\n"
+            << "  --zp <first>-<last>  zero page bytes to fuzz (00-ff)\n"
+            << "  --io <first>-<last>  IO page bytes to fuzz (none)\n"
+            << "  --cycles <n>         budget before a run counts as a hang\n"
+            << "  --runs <n>           stop after n runs (never)\n"
+            << "  --seed <n>           random seed\n"
+            << "  --out <dir>          save new coverage, hangs and crashes\n"
+            << "  --cmos               run a 65C02" << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::vector<InputRange> ranges;
+  uint64_t budget = 1000000;
+  uint64_t max_runs = 0;
+  uint64_t seed = std::random_device{}();
+  std::string out_dir;
+  CpuVariant variant = CpuVariant::NMOS;
+  for (int i = 3; i < argc; i++) {
+    std::string arg = argv[i];
+    InputRange range;
+    if (arg == "--zp" && i + 1 < argc &&
+        parse_range(argv[++i], Regions::ZPG.begin, range)) {
+      ranges.push_back(range);
+    } else if (arg == "--io" && i + 1 < argc &&
+               parse_range(argv[++i], Regions::IO.begin, range)) {
+      ranges.push_back(range);
+    } else if (arg == "--cycles" && i + 1 < argc) {
+      budget = std::stoull(argv[++i]);
+    } else if (arg == "--runs" && i + 1 < argc) {
+      max_runs = std::stoull(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = std::stoull(argv[++i]);
+    } else if (arg == "--out" && i + 1 < argc) {
+      out_dir = std::string(argv[++i]) + "/";
+    } else if (arg == "--cmos") {
+      variant = CpuVariant::CMOS;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (ranges.empty()) ranges.push_back({Regions::ZPG.begin, 0, 0xFF});
+
+  std::ifstream rom(argv[1], std::ios::binary);
+  std::vector<uint8_t> memory(std::istreambuf_iterator<char>(rom), {});
+  if (memory.size() != ADDR_SPACE_SZ) {
+    std::cerr << argv[1] << ": expected a " << ADDR_SPACE_SZ << " byte image"
+              << std::endl;
+    return 1;
+  }
+  word_t entry = std::stoul(argv[2], nullptr, 16);
+
+  Processor proc(memory, variant);
+  // Guest logging would drown the progress lines, and slow every run.
+  proc.console_to(-1);
+  Processor::Registers regs = proc.registers();
+  regs.PC = entry;
+  proc.set_registers(regs);
+  Snapshot snapshot(proc);
+
+  size_t input_size = 0;
+  for (const InputRange &range : ranges) input_size += range.size();
+  std::vector<std::vector<uint8_t>> corpus;
+  std::vector<uint8_t> input(input_size, 0);
+  BranchCoverage &coverage = proc.coverage();
+  coverage.fill(0);
+  std::vector<uint32_t> slots = branch_slots(memory, variant);
+  auto seen = std::make_unique<BranchCoverage>();
+
+  current_input = &input;
+  snprintf(crash_path, sizeof(crash_path), "%scrash", out_dir.c_str());
+  signal(SIGABRT, on_abort);
+
+  std::mt19937_64 rng(seed);
+  uint64_t hangs = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto last_report = start;
+  uint64_t runs = 0;
+  for (; !max_runs || runs < max_runs; runs++) {
+    if (!corpus.empty()) {
+      input = corpus[rng() % corpus.size()];
+      mutate(input, corpus, rng);
+    }
+
+    snapshot.restore();
+    size_t at = 0;
+    for (const InputRange &range : ranges) {
+      word_t addr = range.page + range.first;
+      memcpy(memory.data() + addr, input.data() + at, range.size());
+      snapshot.touch(addr, range.size());
+      at += range.size();
+    }
+    // Still running at the end of the budget means it didn't return.
+    bool hung = proc.run_until(proc.cycle_count() + budget);
+
+    // Hangs are kept only when they reach new code, like other inputs, so
+    // that one infinite loop doesn't fill the output with copies of itself.
+    bool novel = merge_coverage(coverage, *seen, slots);
+    hangs += hung;
+    if (novel && !hung) corpus.push_back(input);
+    if (novel && !out_dir.empty()) {
+      save(out_dir + (hung ? "hang-" : "cov-") + std::to_string(runs), input);
+    }
+
+    if ((runs & 0xFFF) == 0) {
+      auto now = std::chrono::steady_clock::now();
+      if (now - last_report >= std::chrono::seconds(1)) {
+        std::chrono::duration<double> elapsed = now - start;
+        std::cout << "runs " << runs << "  exec/s "
+                  << (uint64_t)(runs / elapsed.count()) << "  corpus "
+                  << corpus.size() << "  edges " << count_edges(*seen)
+                  << "  hangs " << hangs << std::endl;
+        last_report = now;
+      }
+    }
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "runs:    " << runs << "\n"
+            << "exec/s:  " << (uint64_t)(runs / elapsed.count()) << "\n"
+            << "corpus:  " << corpus.size() << "\n"
+            << "edges:   " << count_edges(*seen) << "\n"
+            << "hangs:   " << hangs << std::endl;
+  return 0;
+}
@@ -0,0 +1,28 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "Recompiler/recompiler.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <rom> <output.cpp>" << std::endl;
+    return 1;
+  }
+  std::ifstream input(argv[1], std::ios::binary);
+  std::vector<uint8_t> image(std::istreambuf_iterator<char>(input), {});
+  if (image.size() != ADDR_SPACE_SZ) {
+    std::cerr << argv[1] << ": expected a " << ADDR_SPACE_SZ << " byte image"
+              << std::endl;
+    return 1;
+  }
+
+  Recompiler recompiler(image);
+  std::ofstream output(argv[2]);
+  recompiler.emit(output);
+  std::cout << argv[2] << ": " << recompiler.entries().size()
+            << " basic blocks" << std::endl;
+  return 0;
+}
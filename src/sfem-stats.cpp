@@ -0,0 +1,60 @@
+#include <time.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Monitor/livestats.h"
+
+namespace {
+void print(const LiveStatsBlock &stats) {
+  constexpr auto relaxed = std::memory_order_relaxed;
+  static const char *THREADS[] = {"cpu", "render", "reload"};
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  uint64_t updated = stats.updated_ns.load(relaxed);
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "pid:           " << stats.pid << "\n"
+            << "version:       " << stats.version << "\n"
+            << "instructions:  " << stats.instructions.load(relaxed) << "\n"
+            << "cycles:        " << stats.cycles.load(relaxed) << "\n"
+            << "MIPS:          " << stats.mips.load(relaxed) << "\n"
+            << "frames:        " << stats.frames.load(relaxed) << "\n"
+            << "reloads:       " << stats.reloads.load(relaxed) << "\n";
+  for (size_t i = 0; i < LiveStatsBlock::NUM_THREADS; i++) {
+    std::cout << std::left << std::setw(15)
+              << (std::string(THREADS[i]) + " thread:") << std::right
+              << stats.thread_ns[i].load(relaxed) / 1e9 << " s\n";
+  }
+  std::cout << "updated:       ";
+  if (updated) {
+    std::cout << (now_ns - std::min(now_ns, updated)) / 1e9 << " s ago\n";
+  } else {
+    std::cout << "never\n";
+  }
+  std::cout << std::flush;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || (argc == 3 && std::string(argv[2]) != "--watch") ||
+      argc > 3) {
+    std::cerr << "usage: " << argv[0] << " <name> [--watch]\n"
+              << "Prints the statistics published by sfem --stats <name>."
+              << std::endl;
+    return 1;
+  }
+  const LiveStatsBlock *stats = open_live_stats(argv[1]);
+  if (!stats) return 1;
+  print(*stats);
+  while (argc == 3) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::cout << "\n";
+    print(*stats);
+  }
+  return 0;
+}
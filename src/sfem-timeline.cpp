@@ -0,0 +1,141 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "6502/InstructionSet/address_space.h"
+#include "Replay/timeline.h"
+
+namespace {
+void print_frame(const Timeline &timeline, size_t i) {
+  const Timeline::Frame &frame = timeline.frame(i);
+  std::cout << std::dec << "frame " << i << "  cycle " << frame.cycle
+            << "  vsync " << frame.vsync;
+}
+
+void print_regs(const Timeline &timeline, size_t i) {
+  const Processor::Registers &regs = timeline.frame(i).regs;
+  print_frame(timeline, i);
+  std::cout << std::hex << std::setfill('0') << "\n  PC $" << std::setw(4)
+            << regs.PC << "  AC $" << std::setw(2) << (int)regs.AC << "  X $"
+            << std::setw(2) << (int)regs.X << "  Y $" << std::setw(2)
+            << (int)regs.Y << "  SR $" << std::setw(2) << (int)regs.SR
+            << "  SP $" << std::setw(2) << (int)regs.SP << std::setfill(' ')
+            << std::endl;
+}
+
+/// Print the value of \p addr at the first frame and at every frame where it
+/// changed.
+void print_values(const Timeline &timeline, word_t addr) {
+  std::optional<uint8_t> last;
+  for (size_t i : timeline.candidates(addr)) {
+    uint8_t value = timeline.byte(addr, i);
+    if (last == value) continue;
+    print_frame(timeline, i);
+    std::cout << "  $" << std::hex << std::setfill('0') << std::setw(2)
+              << (int)value << std::setfill(' ') << std::endl;
+    last = value;
+  }
+}
+
+/// All of \p text as a number in \p base, if it is one no larger than \p max.
+std::optional<uint64_t> parse(const char *text, int base, uint64_t max) {
+  if (base == 16 && (!strncmp(text, "0x", 2) || !strncmp(text, "0X", 2))) {
+    text += 2;
+  }
+  const char *end = text + strlen(text);
+  uint64_t value;
+  auto [rest, error] = std::from_chars(text, end, value, base);
+  if (error != std::errc() || rest != end || value > max) return std::nullopt;
+  return value;
+}
+
+std::optional<word_t> parse_addr(const char *text) {
+  return parse(text, 16, ADDR_SPACE_SZ - 1);
+}
+
+std::optional<size_t> parse_frame(const char *text) {
+  return parse(text, 10, SIZE_MAX);
+}
+
+void usage(const char *argv0) {
+  std::cerr << "usage: " << argv0 << " <timeline> <query>\n"
+            << "Answers questions about a recording of sfem --timeline.\n"
+            << "  info                      frames and cycles recorded\n"
+            << "  regs <frame>              registers at a frame\n"
+            << "  value <addr>              value of a byte over time\n"
+            << "  first-change <addr> [n]   first frame after frame n\n"
+            << "                            where a byte changed (0)\n"
+            << "Addresses are in hex, up to FFFF; frames in decimal."
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  Timeline timeline;
+  if (!timeline.load(argv[1])) {
+    std::cerr << argv[1] << ": not a timeline" << std::endl;
+    return 1;
+  }
+  std::string query = argv[2];
+  if (query == "info" && argc == 3) {
+    const Timeline::Frame &last = timeline.frame(timeline.size() - 1);
+    std::cout << "frames:  " << timeline.size() << "\n"
+              << "cycles:  " << timeline.frame(0).cycle << " to "
+              << last.cycle << "\n"
+              << "vsyncs:  " << timeline.frame(0).vsync << " to "
+              << last.vsync << "\n"
+              << "index:   "
+              << (timeline.complete() ? "yes" : "no, recording cut short")
+              << std::endl;
+  } else if (query == "regs" && argc == 4) {
+    std::optional<size_t> i = parse_frame(argv[3]);
+    if (!i) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (*i >= timeline.size()) {
+      std::cerr << "only " << timeline.size() << " frames" << std::endl;
+      return 1;
+    }
+    print_regs(timeline, *i);
+  } else if (query == "value" && argc == 4) {
+    std::optional<word_t> addr = parse_addr(argv[3]);
+    if (!addr) {
+      usage(argv[0]);
+      return 1;
+    }
+    print_values(timeline, *addr);
+  } else if (query == "first-change" && (argc == 4 || argc == 5)) {
+    std::optional<word_t> addr = parse_addr(argv[3]);
+    std::optional<size_t> from = argc == 5 ? parse_frame(argv[4]) : 0;
+    if (!addr || !from) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (*from >= timeline.size()) {
+      std::cerr << "only " << timeline.size() << " frames" << std::endl;
+      return 1;
+    }
+    std::optional<size_t> changed = timeline.first_change(*addr, *from);
+    if (!changed) {
+      std::cout << "never changes after frame " << *from << std::endl;
+      return 0;
+    }
+    print_frame(timeline, *changed);
+    std::cout << "  $" << std::hex << std::setfill('0') << std::setw(2)
+              << (int)timeline.byte(*addr, *from) << " -> $" << std::setw(2)
+              << (int)timeline.byte(*addr, *changed) << std::endl;
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+  return 0;
+}
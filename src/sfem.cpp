@@ -1,64 +1,281 @@
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <string>
 #include <thread>
 
 #include "6502/InstructionSet/address_space.h"
 #include "6502/processor.h"
+#include "6502/profiler.h"
+#include "6502/sharedimage.h"
 #include "HotReload/filewatcher.h"
-#include "raylib.h"
-
-void draw_loop(const Processor &proc) {
-  SetTraceLogLevel(LOG_ERROR);
-  auto scaleFac = 16;
-  InitWindow(Display::width * scaleFac, Display::height * scaleFac, "[6502]");
-  const uint8_t *begin_disp = proc.memory().data() + Regions::DISPLAY.begin;
-  while (!WindowShouldClose()) {
-    BeginDrawing();
-    ClearBackground(RAYWHITE);
-    for (int x = 0; x < Display::width; x++) {
-      for (int y = 0; y < Display::height; y++) {
-        if (Display::read_pix(begin_disp, x, y)) {
-          if (x & 1) {
-            DrawRectangle(x * scaleFac, y * scaleFac, scaleFac, scaleFac,
-                          WHITE);
-          } else {
-            DrawRectangle(x * scaleFac, y * scaleFac, scaleFac, scaleFac,
-                          WHITE);
-          }
-        } else {
-          DrawRectangle(x * scaleFac, y * scaleFac, scaleFac, scaleFac, BLACK);
-        }
-      }
-    }
-    EndDrawing();
-  }
-  CloseWindow();
-}
+#include "Monitor/livestats.h"
+#include "Render/capture.h"
+#include "Render/window.h"
+#include "Replay/inputlog.h"
+#include "Replay/timeline.h"
+#include "Sound/samplering.h"
+#include "Sound/speaker.h"
+#include "Sound/wavwriter.h"
 
-void reload_loop(Processor &proc, const char *fpath) {
-  FileWatcher watcher(fpath, [fpath, &proc]() {
+/// Reload every one of \p procs whenever the ROM at \p fpath is rewritten.
+void watch_rom(FileWatcher &watcher, std::vector<Processor *> procs,
+               const char *fpath) {
+  watcher.watch(fpath, [fpath, procs]() {
     std::ifstream input(fpath, std::ios::binary);
     std::vector<uint8_t> new_mem(std::istreambuf_iterator<char>(input), {});
-    assert(new_mem.size() == ADDR_SPACE_SZ &&
-           "given executable incorrect size");
-    proc.set_reset(new_mem.data());
+    if (new_mem.size() != ADDR_SPACE_SZ) {
+      // Likely caught mid-build; the final write triggers another reload.
+      std::cerr << fpath << ": not a ROM image, not reloading" << std::endl;
+      return;
+    }
+    HostEvent reload = HostEvent::reload(std::move(new_mem));
+    for (Processor *proc : procs) proc->post(reload);
   });
 }
 
+/// Run \p count machines on the ROM at \p fpath in one window, each on its
+/// own thread. They share the image, copying a page only once they write it.
+int run_grid(const char *fpath, size_t count) {
+  std::ifstream input(fpath, std::ios::binary);
+  std::vector<uint8_t> memory(std::istreambuf_iterator<char>(input), {});
+  if (memory.size() != ADDR_SPACE_SZ) {
+    std::cerr << fpath << ": not a ROM image" << std::endl;
+    return 1;
+  }
+  SharedImage image(memory);
+  if (!image.valid()) return 1;
+
+  std::vector<SharedImage::View> views;
+  std::vector<std::unique_ptr<Processor>> owned;
+  std::vector<Processor *> procs;
+  for (size_t i = 0; i < count; i++) {
+    views.emplace_back(image);
+    if (!views.back().data()) return 1;
+    owned.push_back(std::make_unique<Processor>(views.back().data()));
+    procs.push_back(owned.back().get());
+  }
+
+  std::vector<std::thread> cpus;
+  for (Processor *proc : procs) cpus.emplace_back(&Processor::run, proc);
+  FileWatcher watcher;
+  watch_rom(watcher, procs, fpath);
+  std::thread reloader(&FileWatcher::run, &watcher);
+  grid_loop(procs);
+
+  for (std::thread &cpu : cpus) cpu.join();
+  watcher.stop();
+  reloader.join();
+  return 0;
+}
+
+/// Re-run a recorded session without a window, as fast as possible, and report
+/// how long it took along with a hash of the final memory.
+int replay_headless(const char *log_path) {
+  InputLog log;
+  if (!log.load(log_path)) {
+    std::cerr << log_path << ": not a recording" << std::endl;
+    return 1;
+  }
+  std::vector<uint8_t> memory = log.image();
+  Processor proc(memory);
+
+  auto start = std::chrono::steady_clock::now();
+  bool stopped = replay(proc, log);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  // FNV-1a, so runs can be compared for bit exactness.
+  uint64_t hash = 0xcbf29ce484222325;
+  for (uint8_t byte : memory) hash = (hash ^ byte) * 0x100000001b3;
+
+  std::cout << "events:  " << log.events().size() << "\n"
+            << "cycles:  " << proc.cycle_count() << "\n"
+            << "seconds: " << elapsed.count() << "\n"
+            << "MHz:     " << proc.cycle_count() / elapsed.count() / 1e6 << "\n"
+            << "memory:  " << std::hex << hash << std::dec << "\n";
+  if (!stopped) std::cout << "guest returned before the end of the recording\n";
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
-  char *fpath = argv[1];
+  const char *fpath = nullptr;
+  const char *record_path = nullptr;
+  const char *capture_path = nullptr;
+  const char *heatmap_path = nullptr;
+  const char *profile_path = nullptr;
+  const char *labels_path = nullptr;
+  const char *stats_name = nullptr;
+  const char *wav_path = nullptr;
+  const char *timeline_path = nullptr;
+  bool headless = false;
+  bool dispatch_stats = false;
+  uint64_t frames = 0;
+  size_t grid = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--replay" && i + 1 < argc) return replay_headless(argv[i + 1]);
+    if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--capture" && i + 1 < argc) {
+      capture_path = argv[++i];
+    } else if (arg == "--frames" && i + 1 < argc) {
+      frames = std::stoull(argv[++i]);
+    } else if (arg == "--heatmap" && i + 1 < argc) {
+      heatmap_path = argv[++i];
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profile_path = argv[++i];
+    } else if (arg == "--labels" && i + 1 < argc) {
+      labels_path = argv[++i];
+    } else if (arg == "--grid" && i + 1 < argc) {
+      grid = std::stoull(argv[++i]);
+    } else if (arg == "--stats" && i + 1 < argc) {
+      stats_name = argv[++i];
+    } else if (arg == "--timeline" && i + 1 < argc) {
+      timeline_path = argv[++i];
+    } else if (arg == "--wav" && i + 1 < argc) {
+      wav_path = argv[++i];
+    } else if (arg == "--headless") {
+      headless = true;
+    } else if (arg == "--dispatch-stats") {
+      dispatch_stats = true;
+    } else {
+      fpath = argv[i];
+    }
+  }
+  if (!fpath || (headless && !capture_path)) {
+    std::cerr << "usage: " << argv[0] << " <rom> [--record <log>]\n"
+              << "           [--capture <dir|file.y4m|file.rgba>]"
+              << " [--headless [--frames <n>]]\n"
+              << "           [--heatmap <png>]"
+              << " [--profile <folded> [--labels <ld65 labels>]]\n"
+              << "           [--stats <shm name>] [--wav <file>]"
+              << " [--timeline <file>]\n"
+              << "           [--dispatch-stats]\n"
+              << "       " << argv[0] << " --grid <n> <rom>\n"
+              << "       " << argv[0] << " --replay <log>" << std::endl;
+    return 1;
+  }
+  if (grid) return run_grid(fpath, grid);
+
   std::ifstream input(fpath, std::ios::binary);
   std::vector<uint8_t> memory(std::istreambuf_iterator<char>(input), {});
   assert(memory.size() == ADDR_SPACE_SZ && "given executable incorrect size");
 
   Processor proc(memory);
+  std::unique_ptr<InputRecorder> recorder;
+  if (record_path) {
+    recorder = std::make_unique<InputRecorder>(record_path, memory);
+    proc.record_to(recorder.get());
+  }
+  std::unique_ptr<CallProfiler> profiler;
+  if (profile_path) {
+    profiler = std::make_unique<CallProfiler>();
+    if (labels_path && !profiler->load_labels(labels_path)) {
+      std::cerr << labels_path << ": can't read labels" << std::endl;
+    }
+    proc.profile_to(profiler.get());
+  }
+  std::unique_ptr<TimelineRecorder> timeline;
+  if (timeline_path) {
+    timeline = std::make_unique<TimelineRecorder>(timeline_path);
+    if (!timeline->valid()) return 1;
+    proc.timeline_to(timeline.get());
+  }
 
-  std::thread renderer(draw_loop, std::cref(proc));
-  std::thread reloader(reload_loop, std::ref(proc), fpath);
-  proc.run();
+  // Sound goes to the file when one is given, else to the speakers, if any.
+  // The guest isn't throttled, so it mostly runs ahead of the speakers and
+  // keeps their ring full: a small one keeps the delay down. A file should
+  // lose nothing, so it gets room for over a second of sound.
+  SampleRing samples(wav_path ? 1 << 16 : 1 << 12);
+  std::unique_ptr<WavWriter> wav;
+  std::unique_ptr<Speaker> speaker;
+  if (wav_path) {
+    wav = std::make_unique<WavWriter>(wav_path, samples,
+                                      AudioUnit::SAMPLE_RATE);
+    if (!wav->valid()) return 1;
+    proc.audio_to(&samples);
+  } else if (!headless && Speaker::available()) {
+    speaker = std::make_unique<Speaker>(samples, AudioUnit::SAMPLE_RATE);
+    proc.audio_to(&samples);
+  }
+
+  std::unique_ptr<FrameCapture> capture;
+  if (capture_path) {
+    capture = std::make_unique<FrameCapture>(capture_path);
+    if (!capture->valid()) return 1;
+  }
 
+  std::thread renderer;
+  if (headless) {
+    renderer = std::thread(capture_loop, std::ref(proc), std::ref(*capture),
+                           frames);
+  } else {
+    renderer = std::thread(draw_loop, std::ref(proc), capture.get());
+  }
+  FileWatcher watcher;
+  watch_rom(watcher, {&proc}, fpath);
+  std::thread reloader(&FileWatcher::run, &watcher);
+  std::unique_ptr<LiveStats> stats;
+  if (stats_name) stats = std::make_unique<LiveStats>(stats_name);
+  if (stats && stats->valid()) {
+    stats->track_thread(LiveStatsBlock::RENDER, renderer.native_handle());
+    stats->track_thread(LiveStatsBlock::RELOAD, reloader.native_handle());
+    // Publish between batches, so the interpreter loop itself is untouched.
+    uint64_t end = proc.cycle_count() + LiveStats::BATCH_CYCLES;
+    while (proc.run_until(end)) {
+      stats->publish(proc);
+      // Returning short of the batch means the guest waits for the host,
+      // which a batch can't get past.
+      if (proc.cycle_count() < end) {
+        proc.wait_for_host();
+      } else {
+        end = proc.cycle_count() + LiveStats::BATCH_CYCLES;
+      }
+    }
+    stats->publish(proc);
+  } else {
+    proc.run();
+  }
+
+  // Without a window nobody else notices the guest returning.
+  if (capture) capture->close();
   renderer.join();
+  speaker.reset();
+  if (wav) {
+    wav->finish();
+    std::cout << "wrote " << wav->samples_written() << " samples, dropped "
+              << samples.dropped() << std::endl;
+  }
+  if (heatmap_path) {
+#ifdef SFEM_HEATMAP
+    if (!proc.heatmap().save_png(heatmap_path)) {
+      std::cerr << heatmap_path << ": can't write the heatmap" << std::endl;
+    }
+#else
+    std::cerr << "--heatmap needs a build with SFEM_HEATMAP on" << std::endl;
+#endif
+  }
+  if (profiler) {
+    profiler->finish(proc.cycle_count());
+    std::ofstream folded(profile_path);
+    profiler->write_collapsed(folded);
+    profiler->print_summary(std::cout);
+  }
+  if (timeline) {
+    timeline->close();
+    std::cout << "recorded " << timeline->frames_written() << " frames"
+              << std::endl;
+  }
+  if (capture) {
+    std::cout << "captured " << capture->frames_written() << " frames, dropped "
+              << capture->frames_dropped() << std::endl;
+  }
+  // Only once the guest has stopped running do the counters hold still.
+  if (dispatch_stats) proc.print_dispatch_stats(std::cout);
+  watcher.stop();
   reloader.join();
   return 0;
 }
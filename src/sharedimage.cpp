@@ -0,0 +1,68 @@
+#include "6502/sharedimage.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "6502/InstructionSet/address_space.h"
+
+SharedImage::SharedImage(const std::vector<uint8_t>& image) {
+  fd = memfd_create("sfem-image", MFD_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "memfd_create failed: " << strerror(errno) << std::endl;
+    return;
+  }
+  if (ftruncate(fd, ADDR_SPACE_SZ) < 0) {
+    std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+    close(fd);
+    fd = -1;
+    return;
+  }
+  // Fill the file through a shared mapping; views map it privately.
+  void* mem =
+      mmap(nullptr, ADDR_SPACE_SZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mem == MAP_FAILED) {
+    std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+    close(fd);
+    fd = -1;
+    return;
+  }
+  memcpy(mem, image.data(), std::min(image.size(), ADDR_SPACE_SZ));
+  munmap(mem, ADDR_SPACE_SZ);
+}
+
+SharedImage::~SharedImage() {
+  // Existing views keep the file alive on their own.
+  if (fd >= 0) close(fd);
+}
+
+SharedImage::View::View(const SharedImage& image) {
+  if (!image.valid()) return;
+  void* m = mmap(nullptr, ADDR_SPACE_SZ, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                 image.fd, 0);
+  if (m == MAP_FAILED) {
+    std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+    return;
+  }
+  mem = static_cast<uint8_t*>(m);
+}
+
+SharedImage::View::~View() {
+  if (mem) munmap(mem, ADDR_SPACE_SZ);
+}
+
+SharedImage::View::View(View&& other) noexcept
+    : mem(std::exchange(other.mem, nullptr)) {}
+
+SharedImage::View& SharedImage::View::operator=(View&& other) noexcept {
+  if (this != &other) {
+    if (mem) munmap(mem, ADDR_SPACE_SZ);
+    mem = std::exchange(other.mem, nullptr);
+  }
+  return *this;
+}
@@ -0,0 +1,68 @@
+#include "6502/snapshot.h"
+
+#include <cstring>
+
+#include "6502/InstructionSet/address_space.h"
+
+Snapshot::Snapshot(Processor &proc)
+    : proc(proc),
+      memory(proc.RAM, proc.RAM + ADDR_SPACE_SZ),
+      regs(proc.registers()),
+      return_SP(proc.return_SP),
+      cycles(proc.cycles),
+      retired(proc.retired),
+      vsyncs(proc.vsyncs),
+      reloads(proc.reloads),
+      frame_start(proc.frame_start),
+      irq_pending(proc.irq_pending),
+      irq_mask(proc.irq_mask),
+      irq_line(proc.irq_line),
+      waiting(proc.waiting),
+      wait_mask(proc.wait_mask),
+      scheduler(proc.scheduler),
+      audio(proc.audio),
+      console_text(proc.console.pending()) {
+  proc.dirty.fill(false);
+  proc.tracking = true;
+  proc.update_page_flags();
+}
+
+Snapshot::~Snapshot() {
+  proc.tracking = false;
+  proc.update_page_flags();
+}
+
+void Snapshot::restore() {
+  size_t io_page = Regions::IO.begin >> 8;
+  proc.dirty[io_page] = true;
+  restored = 0;
+  for (size_t page = 0; page < proc.dirty.size(); page++) {
+    if (!proc.dirty[page]) continue;
+    memcpy(proc.RAM + page * PAGE_SZ, memory.data() + page * PAGE_SZ,
+           PAGE_SZ);
+    proc.dirty[page] = false;
+    proc.page_flags[page] |= Processor::PAGE_TRACK;
+    ++restored;
+  }
+
+  proc.set_registers(regs);
+  proc.return_SP = return_SP;
+  proc.cycles = cycles;
+  proc.retired = retired;
+  proc.vsyncs = vsyncs;
+  proc.reloads = reloads;
+  proc.frame_start = frame_start;
+  proc.irq_pending = irq_pending;
+  proc.irq_mask = irq_mask;
+  proc.irq_line = irq_line;
+  proc.waiting = waiting;
+  proc.wait_mask = wait_mask;
+  proc.scheduler = scheduler;
+  // The sound generator's clock goes back with the guest's, so rendering
+  // carries on from the snapshot rather than from a cycle in its future.
+  proc.audio = audio;
+  proc.console.set_pending(console_text);
+  proc.hit.reset();
+  proc.watch_stop = false;
+  proc.resume_PC = UINT32_MAX;
+}
@@ -0,0 +1,254 @@
+// Instructions outside the documented NMOS set, for the CPU variants in
+// instrs.h. They are rare enough in practice that each is decoded from its
+// descriptor here rather than getting its own case in the interpreter.
+
+#include "6502/InstructionSet/arithmetic.h"
+#include "6502/processor.h"
+
+#define SET_NZ(n)        \
+  SR.N = (n) & SIGN_BIT; \
+  SR.Z = (n) == 0;
+
+word_t Processor::operand_address(const InstDesc &desc) {
+  word_t base;
+  word_t addr;
+  switch (desc.mode) {
+    case AdrMode::ZPG:
+      return read(PC + 1);
+    case AdrMode::ZP_X:
+      return (uint8_t)(read(PC + 1) + X);
+    case AdrMode::ZP_Y:
+      return (uint8_t)(read(PC + 1) + Y);
+    case AdrMode::ABS:
+      return read_word(PC + 1);
+    case AdrMode::ABS_X:
+      base = read_word(PC + 1);
+      addr = base + X;
+      break;
+    case AdrMode::ABS_Y:
+      base = read_word(PC + 1);
+      addr = base + Y;
+      break;
+    case AdrMode::X_IND:
+      return zread_word((uint8_t)(read(PC + 1) + X));
+    case AdrMode::IND_Y:
+      base = zread_word(read(PC + 1));
+      addr = base + Y;
+      break;
+    case AdrMode::ZPG_IND:
+      return zread_word(read(PC + 1));
+    case AdrMode::ABS_X_IND:
+      return read_word(read_word(PC + 1) + X);
+    default:
+      return PC + 1;
+  }
+  cycles += desc.page_penalty && crosses_page(base, addr);
+  return addr;
+}
+
+template <bool WATCH>
+bool Processor::run_undocumented(const InstDesc &desc) {
+  word_t addr = operand_address(desc);
+  uint8_t value;
+  switch (desc.mon) {
+    case Mnemonic::NOP:
+      // Still reads its operand, which matters on the IO page.
+      if (desc.mode != AdrMode::IMP) load<WATCH>(addr);
+      break;
+    case Mnemonic::SBC:
+      apply_arith(ArithTables::SBC[ArithTables::index(SR.D, SR.C, AC,
+                                                      read(addr))]);
+      break;
+    case Mnemonic::SLO:
+      value = load<WATCH>(addr);
+      SR.C = value & SIGN_BIT;
+      value <<= 1;
+      write(addr, value);
+      AC |= value;
+      SET_NZ(AC);
+      break;
+    case Mnemonic::RLA: {
+      value = load<WATCH>(addr);
+      bool carry = value & SIGN_BIT;
+      value = value << 1 | SR.C;
+      SR.C = carry;
+      write(addr, value);
+      AC &= value;
+      SET_NZ(AC);
+      break;
+    }
+    case Mnemonic::SRE:
+      value = load<WATCH>(addr);
+      SR.C = value & 1;
+      value >>= 1;
+      write(addr, value);
+      AC ^= value;
+      SET_NZ(AC);
+      break;
+    case Mnemonic::RRA: {
+      value = load<WATCH>(addr);
+      bool carry = value & 1;
+      value = value >> 1 | SR.C << 7;
+      SR.C = carry;
+      write(addr, value);
+      apply_arith(ArithTables::ADC[ArithTables::index(SR.D, SR.C, AC, value)]);
+      break;
+    }
+    case Mnemonic::SAX:
+      write(addr, AC & X);
+      break;
+    case Mnemonic::LAX:
+      AC = X = load<WATCH>(addr);
+      SET_NZ(AC);
+      break;
+    case Mnemonic::DCP:
+      value = load<WATCH>(addr) - 1;
+      write(addr, value);
+      SR.C = AC >= value;
+      SET_NZ((uint8_t)(AC - value));
+      break;
+    case Mnemonic::ISC:
+      value = load<WATCH>(addr) + 1;
+      write(addr, value);
+      apply_arith(ArithTables::SBC[ArithTables::index(SR.D, SR.C, AC, value)]);
+      break;
+    case Mnemonic::ANC:
+      AC &= read(addr);
+      SET_NZ(AC);
+      SR.C = SR.N;
+      break;
+    case Mnemonic::ALR:
+      AC &= read(addr);
+      SR.C = AC & 1;
+      AC >>= 1;
+      SET_NZ(AC);
+      break;
+    case Mnemonic::ARR:
+      AC &= read(addr);
+      AC = AC >> 1 | SR.C << 7;
+      SET_NZ(AC);
+      SR.C = AC & 0x40;
+      SR.V = ((AC >> 6) ^ (AC >> 5)) & 1;
+      break;
+    case Mnemonic::SBX: {
+      uint8_t both = AC & X;
+      value = read(addr);
+      SR.C = both >= value;
+      X = both - value;
+      SET_NZ(X);
+      break;
+    }
+    default:
+      return false;
+  }
+  PC += desc.sz;
+  return true;
+}
+
+template <bool WATCH>
+bool Processor::run_65c02(const InstDesc &desc) {
+  if (desc.mon == Mnemonic::BRA) {
+    branch(true, PC);
+    return true;
+  }
+  if (desc.mon == Mnemonic::JMP) {
+    PC = operand_address(desc);
+    return true;
+  }
+
+  word_t addr = operand_address(desc);
+  uint8_t value;
+  switch (desc.mon) {
+    case Mnemonic::NOP:
+      // Like the NMOS ones, a NOP with an operand still reads it.
+      if (desc.mode != AdrMode::IMP) load<WATCH>(addr);
+      break;
+    case Mnemonic::STZ:
+      write(addr, 0);
+      break;
+    case Mnemonic::PHX:
+      push(X);
+      break;
+    case Mnemonic::PHY:
+      push(Y);
+      break;
+    case Mnemonic::PLX:
+      X = pop();
+      SET_NZ(X);
+      break;
+    case Mnemonic::PLY:
+      Y = pop();
+      SET_NZ(Y);
+      break;
+    case Mnemonic::TSB:
+      value = load<WATCH>(addr);
+      SR.Z = (value & AC) == 0;
+      write(addr, value | AC);
+      break;
+    case Mnemonic::TRB:
+      value = load<WATCH>(addr);
+      SR.Z = (value & AC) == 0;
+      write(addr, value & ~AC);
+      break;
+    case Mnemonic::INC:
+      ++AC;
+      SET_NZ(AC);
+      break;
+    case Mnemonic::DEC:
+      --AC;
+      SET_NZ(AC);
+      break;
+    case Mnemonic::BIT:
+      value = load<WATCH>(addr);
+      SR.Z = (AC & value) == 0;
+      // The immediate form has no memory to take N and V from.
+      if (desc.mode != AdrMode::IMM) {
+        SR.V = value & 0x40;
+        SR.N = value & SIGN_BIT;
+      }
+      break;
+    // The (zp) address mode.
+    case Mnemonic::ORA:
+      AC |= load<WATCH>(addr);
+      SET_NZ(AC);
+      break;
+    case Mnemonic::AND:
+      AC &= load<WATCH>(addr);
+      SET_NZ(AC);
+      break;
+    case Mnemonic::EOR:
+      AC ^= load<WATCH>(addr);
+      SET_NZ(AC);
+      break;
+    case Mnemonic::ADC:
+      value = load<WATCH>(addr);
+      apply_arith(ArithTables::ADC[ArithTables::index(SR.D, SR.C, AC, value)]);
+      break;
+    case Mnemonic::SBC:
+      value = load<WATCH>(addr);
+      apply_arith(ArithTables::SBC[ArithTables::index(SR.D, SR.C, AC, value)]);
+      break;
+    case Mnemonic::STA:
+      write(addr, AC);
+      break;
+    case Mnemonic::LDA:
+      AC = load<WATCH>(addr);
+      SET_NZ(AC);
+      break;
+    case Mnemonic::CMP:
+      value = load<WATCH>(addr);
+      SR.C = AC >= value;
+      SET_NZ((uint8_t)(AC - value));
+      break;
+    default:
+      return false;
+  }
+  PC += desc.sz;
+  return true;
+}
+
+template bool Processor::run_undocumented<false>(const InstDesc &desc);
+template bool Processor::run_undocumented<true>(const InstDesc &desc);
+template bool Processor::run_65c02<false>(const InstDesc &desc);
+template bool Processor::run_65c02<true>(const InstDesc &desc);
+#undef SET_NZ
@@ -0,0 +1,39 @@
+#include "6502/watchpoints.h"
+
+int WatchList::add(word_t first, word_t last, uint8_t kinds) {
+  watches.push_back({first, last, kinds});
+  if (kinds) ++active;
+  rebuild_pages();
+  return watches.size() - 1;
+}
+
+void WatchList::remove(int id) {
+  if (id < 0 || (size_t)id >= watches.size() || !watches[id].kinds) return;
+  watches[id].kinds = 0;
+  --active;
+  rebuild_pages();
+}
+
+void WatchList::clear() {
+  watches.clear();
+  active = 0;
+  page_kinds.fill(0);
+}
+
+bool WatchList::matches(word_t addr, WatchKind kind) const {
+  for (const Watch& watch : watches) {
+    if (watch.kinds & kind && watch.first <= addr && addr <= watch.last) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WatchList::rebuild_pages() {
+  page_kinds.fill(0);
+  for (const Watch& watch : watches) {
+    for (unsigned page = watch.first >> 8; page <= (watch.last >> 8u); page++) {
+      page_kinds[page] |= watch.kinds;
+    }
+  }
+}
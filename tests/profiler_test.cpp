@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "6502/InstructionSet/address_space.h"
+#include "6502/processor.h"
+#include "6502/profiler.h"
+#include "Devices/interrupts.h"
+
+namespace {
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (ok) return;
+  std::cerr << "FAIL: " << what << std::endl;
+  ++failures;
+}
+
+/// Append "LDA #value; STA addr".
+void store(std::vector<uint8_t> &code, uint8_t value, word_t addr) {
+  code.insert(code.end(), {0xA9, value, 0x8D, (uint8_t)(addr & 0xFF),
+                           (uint8_t)(addr >> 8)});
+}
+
+/// A timer interrupt every 200 cycles while the main routine spins. The
+/// handler's cycles must end at its RTI, not run on into the main routine.
+void timer_irq_is_charged_to_its_handler() {
+  constexpr word_t MAIN = Regions::BOOTLOADER_ADDR;
+  constexpr word_t HANDLER = 0x1000;
+  std::vector<uint8_t> memory(ADDR_SPACE_SZ, 0);
+  memory[IRQ_VECTOR] = HANDLER & 0xFF;
+  memory[IRQ_VECTOR + 1] = HANDLER >> 8;
+
+  std::vector<uint8_t> main;
+  store(main, 200, IO::timer_period);
+  store(main, 0, IO::timer_period + 1);
+  store(main, IRQ_TIMER, IO::irq_enable);
+  store(main, TIMER_RUN, IO::timer_ctrl);
+  // CLI; LDY #0; LDX #0; loop: INX; BNE loop; INY; CPY #64; BNE loop; SEI
+  main.insert(main.end(), {0x58, 0xA0, 0x00, 0xA2, 0x00, 0xE8, 0xD0, 0xFD,
+                           0xC8, 0xC0, 0x40, 0xD0, 0xF8, 0x78});
+  store(main, 0, IO::timer_ctrl);
+  main.push_back(0x60);  // RTS
+  std::copy(main.begin(), main.end(), memory.begin() + MAIN);
+
+  // PHA; LDA #IRQ_TIMER; STA irq_status; PLA; RTI
+  const uint8_t handler[] = {0x48, 0xA9, IRQ_TIMER, 0x8D,
+                             IO::irq_status & 0xFF, IO::irq_status >> 8,
+                             0x68, 0x40};
+  std::copy(std::begin(handler), std::end(handler), memory.begin() + HANDLER);
+  constexpr uint64_t HANDLER_CYCLES = 3 + 2 + 4 + 4 + 6;
+
+  Processor proc(memory);
+  CallProfiler profiler(MAIN, proc.cycle_count());
+  proc.profile_to(&profiler);
+  proc.run();
+  profiler.finish(proc.cycle_count());
+
+  const CallProfiler::RoutineStats &irq = profiler.stats(HANDLER);
+  const CallProfiler::RoutineStats &top = profiler.stats(MAIN);
+  check(irq.calls > 100, "the timer interrupts the main routine");
+  check(irq.exclusive == irq.calls * HANDLER_CYCLES,
+        "the handler is charged exactly its own cycles");
+  check(irq.inclusive == irq.exclusive, "the handler calls nothing");
+  check(top.exclusive + irq.exclusive == proc.cycle_count(),
+        "every other cycle is charged to the main routine");
+  check(top.exclusive > irq.exclusive, "the main routine does most work");
+}
+}  // namespace
+
+int main() {
+  timer_irq_is_charged_to_its_handler();
+  if (failures) return EXIT_FAILURE;
+  std::cout << "profiler_test passed" << std::endl;
+  return EXIT_SUCCESS;
+}